@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Counts calls to the global operator new of the whole program, like the allocations checker of
+// the tests. Include it from the one translation unit of a benchmark that reports allocations/op
+
+inline std::atomic<size_t> allocation_count{0};
+
+inline size_t AllocationCount() {
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
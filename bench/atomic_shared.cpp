@@ -0,0 +1,56 @@
+// AtomicSharedPtr against std::atomic<std::shared_ptr> with one shared slot,
+// read-mostly (1 store per 100 operations) and write-heavy (1 store per 2) mixes on 1-64 threads
+
+#include "bench.h"
+
+#include <shared-from-this/atomic_shared.h>
+
+#include <atomic>
+#include <memory>
+
+namespace {
+
+constexpr size_t kIterations = 200'000;
+constexpr int kThreadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+
+template <typename Atomic, typename Make>
+double Mix(Atomic& atomic, Make make, int threads, size_t store_every) {
+    double total = MeasureThreads(threads, [&](int index) {
+        auto own = make(index);
+        for (size_t i = 0; i < kIterations; ++i) {
+            if (i % store_every == 0) {
+                if constexpr (std::is_same_v<Atomic, std::atomic<std::shared_ptr<int>>>) {
+                    atomic.store(own);
+                } else {
+                    atomic.Store(own);
+                }
+            } else {
+                if constexpr (std::is_same_v<Atomic, std::atomic<std::shared_ptr<int>>>) {
+                    DoNotOptimize(atomic.load());
+                } else {
+                    DoNotOptimize(atomic.Load());
+                }
+            }
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+}  // namespace
+
+int main() {
+    AtomicSharedPtr<int> ours(MakeShared<int>(0));
+    std::atomic<std::shared_ptr<int>> theirs(std::make_shared<int>(0));
+    auto make_ours = [](int index) { return MakeShared<int>(index); };
+    auto make_theirs = [](int index) { return std::make_shared<int>(index); };
+
+    for (int threads : kThreadCounts) {
+        PrintRow("AtomicSharedPtr read-mostly", threads, Mix(ours, make_ours, threads, 100));
+        PrintRow("std::atomic<shared_ptr> read-mostly", threads,
+                 Mix(theirs, make_theirs, threads, 100));
+        PrintRow("AtomicSharedPtr write-heavy", threads, Mix(ours, make_ours, threads, 2));
+        PrintRow("std::atomic<shared_ptr> write-heavy", threads,
+                 Mix(theirs, make_theirs, threads, 2));
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Runs `func(thread_index)` on `threads` threads at once and returns wall time in nanoseconds
+template <typename F>
+double MeasureThreads(int threads, F func) {
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(func, i);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    auto finish = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(finish - start).count();
+}
+
+// Runs `func()` `iterations` times on the current thread and returns ns/op
+template <typename F>
+double MeasureLoop(size_t iterations, F func) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        func();
+    }
+    auto finish = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(finish - start).count() /
+           static_cast<double>(iterations);
+}
+
+// Keeps the compiler from optimizing away a computed value
+template <typename T>
+void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void PrintRow(const char* name, int threads, double ns_per_op) {
+    std::printf("%-40s threads=%-3d %10.2f ns/op\n", name, threads, ns_per_op);
+}
+
+// One measured operation of a suite, printed as a row or as JSON
+struct BenchResult {
+    const char* name;
+    const char* impl;
+    double ns_per_op;
+    double allocations_per_op;
+};
+
+inline void PrintResult(const BenchResult& result) {
+    std::printf("%-40s %-20s %10.2f ns/op %6.2f allocs/op\n", result.name, result.impl,
+                result.ns_per_op, result.allocations_per_op);
+}
+
+// Names and implementations are plain identifiers, so nothing needs escaping
+inline void PrintJson(const std::vector<BenchResult>& results) {
+    std::printf("[\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        std::printf("  {\"name\": \"%s\", \"impl\": \"%s\", \"ns_per_op\": %.3f, "
+                    "\"allocations_per_op\": %.3f}%s\n",
+                    result.name, result.impl, result.ns_per_op, result.allocations_per_op,
+                    i + 1 == results.size() ? "" : ",");
+    }
+    std::printf("]\n");
+}
@@ -0,0 +1,64 @@
+// Owner-heavy copy/destroy workloads: biased counting against the atomic
+// and single-threaded policies
+
+#include "bench.h"
+
+#include <shared-from-this/biased.h>
+
+#include <atomic>
+
+namespace {
+
+constexpr size_t kIterations = 10'000'000;
+constexpr int kRemoteThreads[] = {0, 1, 3, 7};
+
+template <typename Ptr>
+double OwnerCopyDestroy(const Ptr& shared) {
+    return MeasureLoop(kIterations, [&shared] {
+        Ptr copy(shared);
+        DoNotOptimize(copy);
+    });
+}
+
+// The owner copies in a tight loop while `remotes` threads copy 100 times less often
+template <typename Ptr>
+double MixedCopyDestroy(const Ptr& shared, int remotes) {
+    std::atomic<bool> stop = false;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < remotes; ++i) {
+        threads.emplace_back([&shared, &stop] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int j = 0; j < 10; ++j) {
+                    Ptr copy(shared);
+                    DoNotOptimize(copy);
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(1));
+            }
+        });
+    }
+
+    double result = OwnerCopyDestroy(shared);
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return result;
+}
+
+}  // namespace
+
+int main() {
+    auto atomic = MakeShared<int>(42);
+    auto biased = MakeShared<int, BiasedPolicy>(42);
+    auto local = MakeShared<int, SingleThreadedPolicy>(42);
+
+    PrintRow("owner copy+destroy atomic", 1, OwnerCopyDestroy(atomic));
+    PrintRow("owner copy+destroy biased", 1, OwnerCopyDestroy(biased));
+    PrintRow("owner copy+destroy single-threaded", 1, OwnerCopyDestroy(local));
+
+    for (int remotes : kRemoteThreads) {
+        PrintRow("owner-heavy mix atomic", remotes + 1, MixedCopyDestroy(atomic, remotes));
+        PrintRow("owner-heavy mix biased", remotes + 1, MixedCopyDestroy(biased, remotes));
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+// Control block sizes, and the cost of a copy and of a last release on one thread.
+// `CopyAndDrop` and `LastRelease` are kept out of line, so their instructions can be counted
+// with `objdump -d --no-show-raw-insn <binary>`.
+
+#include "bench.h"
+
+#include <shared-from-this/shared.h>
+
+namespace {
+
+constexpr size_t kIterations = 10'000'000;
+
+struct Large {
+    char data[64];
+};
+
+}  // namespace
+
+__attribute__((noinline)) void CopyAndDrop(const SharedPtr<int>& source) {
+    SharedPtr<int> copy = source;
+    DoNotOptimize(copy);
+}
+
+__attribute__((noinline)) void LastRelease(SharedPtr<int>& source) {
+    source.Reset();
+}
+
+int main() {
+    std::printf("sizeof(ControlBlockBase)         %zu\n", sizeof(ControlBlockBase));
+    std::printf("sizeof(DefaultBlock<int>)        %zu\n", sizeof(DefaultBlock<int>));
+    std::printf("sizeof(InlineBlock<int>)         %zu\n", sizeof(InlineBlock<int>));
+    std::printf("sizeof(InlineBlock<Large>)       %zu\n", sizeof(InlineBlock<Large>));
+
+    auto shared = MakeShared<int>(42);
+    PrintRow("copy + destroy", 1, MeasureLoop(kIterations, [&shared]() { CopyAndDrop(shared); }));
+    PrintRow("MakeShared + last release", 1, MeasureLoop(kIterations, []() {
+                 auto local = MakeShared<int>(42);
+                 LastRelease(local);
+             }));
+    PrintRow("new + last release", 1, MeasureLoop(kIterations, []() {
+                 SharedPtr<int> local(new int(42));
+                 LastRelease(local);
+             }));
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Counter contention of the default control block against PaddedPolicy on 1-64 threads, in
+// wall ns per iteration, flat while threads do not slow each other down:
+// - "one block": every thread copies and destroys the same pointer, so the counter line is
+//   truly shared and padding cannot help
+// - "neighbor blocks": thread i copies its own pointer to an object allocated right after the
+//   one of thread i - 1, so without padding a few blocks share each cache line
+// - "copy next to writer": threads come in pairs, one copies the pointer, the other writes the
+//   object, which shares a line with the counters unless padded
+
+#include "bench.h"
+
+#include <shared-from-this/padded.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+constexpr size_t kIterations = 1'000'000;
+constexpr int kThreadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+constexpr int kMaxThreads = 64;
+
+struct Counter {
+    long value = 0;
+};
+
+template <typename Policy>
+using Ptr = SharedPtr<Counter, Policy>;
+
+// Allocated one after the other, so that the blocks are neighbors
+template <typename Policy>
+std::vector<Ptr<Policy>> MakeBlocks() {
+    std::vector<Ptr<Policy>> blocks;
+    blocks.reserve(kMaxThreads);
+    for (int i = 0; i < kMaxThreads; ++i) {
+        blocks.push_back(MakeShared<Counter, Policy>());
+    }
+    return blocks;
+}
+
+template <typename Policy>
+double OneBlock(int threads) {
+    auto shared = MakeShared<Counter, Policy>();
+    double total = MeasureThreads(threads, [&shared](int) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            Ptr<Policy> copy(shared);
+            DoNotOptimize(copy);
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+template <typename Policy>
+double NeighborBlocks(const std::vector<Ptr<Policy>>& blocks, int threads) {
+    double total = MeasureThreads(threads, [&blocks](int index) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            Ptr<Policy> copy(blocks[index]);
+            DoNotOptimize(copy);
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+template <typename Policy>
+double CopyNextToWriter(const std::vector<Ptr<Policy>>& blocks, int threads) {
+    double total = MeasureThreads(threads, [&blocks](int index) {
+        const auto& block = blocks[index / 2];
+        for (size_t i = 0; i < kIterations; ++i) {
+            if (index % 2 == 0) {
+                Ptr<Policy> copy(block);
+                DoNotOptimize(copy);
+            } else {
+                ++block->value;
+                DoNotOptimize(block->value);
+            }
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+template <typename Policy>
+void PrintLayout(const char* name, const std::vector<Ptr<Policy>>& blocks) {
+    auto first = reinterpret_cast<uintptr_t>(blocks[0].Get());
+    auto second = reinterpret_cast<uintptr_t>(blocks[1].Get());
+    std::printf("%-40s %zu bytes per block, neighbors %td bytes apart\n", name,
+                sizeof(InlineBlock<Counter, typename Policy::BlockBase>),
+                static_cast<ptrdiff_t>(second - first));
+}
+
+}  // namespace
+
+int main() {
+    auto blocks = MakeBlocks<AtomicPolicy>();
+    auto padded = MakeBlocks<PaddedPolicy>();
+    PrintLayout("SharedPtr", blocks);
+    PrintLayout("SharedPtr<PaddedPolicy>", padded);
+
+    for (int threads : kThreadCounts) {
+        PrintRow("SharedPtr one block", threads, OneBlock<AtomicPolicy>(threads));
+        PrintRow("SharedPtr<Padded> one block", threads, OneBlock<PaddedPolicy>(threads));
+    }
+    for (int threads : kThreadCounts) {
+        PrintRow("SharedPtr neighbor blocks", threads, NeighborBlocks(blocks, threads));
+        PrintRow("SharedPtr<Padded> neighbor blocks", threads, NeighborBlocks(padded, threads));
+    }
+    for (int threads : kThreadCounts) {
+        if (threads < 2) {
+            continue;
+        }
+        PrintRow("SharedPtr copy next to writer", threads, CopyNextToWriter(blocks, threads));
+        PrintRow("SharedPtr<Padded> copy next to writer", threads,
+                 CopyNextToWriter(padded, threads));
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+// A document passed by value through a chain of kStages pipeline stages, as a plain value and as
+// Cow<Document>. Each stage reads one field; a stage writes with the given probability. Plain values
+// pay a deep copy per stage, Cow only per write to a shared document.
+
+#include "bench.h"
+
+#include <shared-from-this/cow.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t kIterations = 2'000;
+constexpr int kStages = 16;
+constexpr size_t kLines = 1'000;
+constexpr double kWriteRates[] = {0.0, 1.0 / kStages, 0.25, 1.0};
+
+struct Document {
+    std::vector<std::string> lines;
+    int version = 0;
+};
+
+Document MakeDocument() {
+    Document document;
+    for (size_t i = 0; i < kLines; ++i) {
+        document.lines.push_back("configuration line number " + std::to_string(i));
+    }
+    return document;
+}
+
+// Takes the document by value and passes a copy on, keeping its own until the chain returns
+size_t Stage(Document document, int stage, const std::vector<bool>& writes,
+             std::mt19937& random) {
+    if (writes[stage]) {
+        ++document.version;
+    }
+    size_t read = document.lines[random() % kLines].size();
+    if (stage + 1 == kStages) {
+        return read + document.version;
+    }
+    return read + Stage(document, stage + 1, writes, random);
+}
+
+size_t Stage(Cow<Document> document, int stage, const std::vector<bool>& writes,
+             std::mt19937& random) {
+    if (writes[stage]) {
+        ++document.Write().version;
+    }
+    size_t read = document->lines[random() % kLines].size();
+    if (stage + 1 == kStages) {
+        return read + document->version;
+    }
+    return read + Stage(document, stage + 1, writes, random);
+}
+
+template <typename Value>
+double Chain(double write_rate) {
+    std::mt19937 random(42);
+    std::bernoulli_distribution write(write_rate);
+    Value document = MakeDocument();
+    std::vector<bool> writes(kStages);
+    return MeasureLoop(kIterations, [&]() {
+        for (int stage = 0; stage < kStages; ++stage) {
+            writes[stage] = write(random);
+        }
+        DoNotOptimize(Stage(document, 0, writes, random));
+    });
+}
+
+}  // namespace
+
+int main() {
+    for (double rate : kWriteRates) {
+        std::printf("write rate %.3f\n", rate);
+        PrintRow("  Document by value, per chain", 1, Chain<Document>(rate));
+        PrintRow("  Cow<Document>, per chain", 1, Chain<Cow<Document>>(rate));
+    }
+    return 0;
+}
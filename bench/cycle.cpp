@@ -0,0 +1,108 @@
+// Cost of CollectCycles() against the size of the graph. Every node points to the next one and to
+// a random one. "dead" drops the last outside reference first, so the whole graph is destroyed;
+// "live" keeps one, so the collector traverses the graph and frees nothing. The last rows split
+// many small dead cycles over calls with a root budget and show the longest pause.
+
+#include "bench.h"
+
+#include <shared-from-this/cycle.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr size_t kGraphSizes[] = {1'000, 10'000, 100'000, 1'000'000};
+constexpr size_t kSmallCycles = 100'000;
+constexpr size_t kSmallCycleSize = 10;
+constexpr size_t kRootBudgets[] = {100, 1'000, 10'000};
+
+struct Node {
+    std::vector<SharedPtr<Node, CyclePolicy>> edges;
+};
+
+using NodePtr = SharedPtr<Node, CyclePolicy>;
+
+}  // namespace
+
+template <>
+struct CycleEdges<Node> {
+    template <typename Visitor>
+    static void ForEach(Node& node, Visitor& visit) {
+        for (NodePtr& edge : node.edges) {
+            visit(edge);
+        }
+    }
+};
+
+namespace {
+
+NodePtr MakeGraph(size_t count, std::mt19937& random) {
+    std::vector<NodePtr> nodes;
+    nodes.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        nodes.push_back(MakeShared<Node, CyclePolicy>());
+    }
+    std::uniform_int_distribution<size_t> pick(0, count - 1);
+    for (size_t i = 0; i < count; ++i) {
+        nodes[i]->edges.push_back(nodes[(i + 1) % count]);
+        nodes[i]->edges.push_back(nodes[pick(random)]);
+    }
+    return nodes[0];
+}
+
+double TimeCollect(size_t max_roots, size_t* collected) {
+    auto start = std::chrono::steady_clock::now();
+    *collected = CollectCycles(max_roots);
+    auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(finish - start).count();
+}
+
+void PrintCollect(const char* name, size_t nodes, double ns, size_t collected) {
+    std::printf("%-24s nodes=%-8zu %12.0f ns %8.2f ns/node collected=%zu\n", name, nodes, ns,
+                ns / static_cast<double>(nodes), collected);
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 random(42);
+    size_t collected = 0;
+
+    for (size_t count : kGraphSizes) {
+        MakeGraph(count, random);
+        double dead = TimeCollect(SIZE_MAX, &collected);
+        PrintCollect("CollectCycles, dead", count, dead, collected);
+
+        NodePtr root = MakeGraph(count, random);
+        {
+            // A candidate in the middle of a live graph
+            NodePtr copy = root->edges[0];
+        }
+        double live = TimeCollect(SIZE_MAX, &collected);
+        PrintCollect("CollectCycles, live", count, live, collected);
+        root.Reset();
+        CollectCycles();
+    }
+
+    for (size_t budget : kRootBudgets) {
+        for (size_t i = 0; i < kSmallCycles; ++i) {
+            MakeGraph(kSmallCycleSize, random);
+        }
+        double longest = 0;
+        double total = 0;
+        size_t calls = 0;
+        while (CycleCollector::Current()->CandidateCount() > 0) {
+            double pause = TimeCollect(budget, &collected);
+            longest = std::max(longest, pause);
+            total += pause;
+            ++calls;
+        }
+        std::printf("%-24s roots/call=%-6zu calls=%-6zu longest=%10.0f ns total=%12.0f ns\n",
+                    "small dead cycles", budget, calls, longest, total);
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+// SharedPtr(new T) churn on 1-64 threads against std::shared_ptr. Build once more with
+// -DSHARED_NO_BLOCK_POOL to measure control blocks allocated with plain new.
+// "handoff" creates the pointers on one thread and drops them on the next one.
+
+#include "bench.h"
+
+#include <shared-from-this/shared.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+constexpr size_t kIterations = 1'000'000;
+constexpr size_t kBatch = 1'000;
+constexpr int kThreadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+
+template <typename Ptr>
+double Churn(int threads) {
+    double total = MeasureThreads(threads, [](int) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            Ptr ptr(new int(42));
+            DoNotOptimize(ptr);
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+// Every thread sends its batches to the next one and drops the ones it receives
+template <typename Ptr>
+double Handoff(int threads) {
+    std::vector<std::vector<Ptr>> inboxes(threads);
+    std::vector<std::mutex> locks(threads);
+    double total = MeasureThreads(threads, [&inboxes, &locks, threads](int index) {
+        int next = (index + 1) % threads;
+        for (size_t round = 0; round < kIterations / kBatch; ++round) {
+            {
+                std::lock_guard lock(locks[next]);
+                for (size_t i = 0; i < kBatch; ++i) {
+                    inboxes[next].emplace_back(new int(42));
+                }
+            }
+            std::vector<Ptr> received;
+            {
+                std::lock_guard lock(locks[index]);
+                received.swap(inboxes[index]);
+            }
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+}  // namespace
+
+int main() {
+#ifdef SHARED_NO_BLOCK_POOL
+    const char* churn = "SharedPtr(new), plain new";
+    const char* handoff = "SharedPtr(new) handoff, plain new";
+#else
+    const char* churn = "SharedPtr(new), BlockPool";
+    const char* handoff = "SharedPtr(new) handoff, BlockPool";
+#endif
+
+    for (int threads : kThreadCounts) {
+        PrintRow(churn, threads, Churn<SharedPtr<int>>(threads));
+        PrintRow("std::shared_ptr(new)", threads, Churn<std::shared_ptr<int>>(threads));
+    }
+    for (int threads : {2, 8}) {
+        PrintRow(handoff, threads, Handoff<SharedPtr<int>>(threads));
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Latency of dropping the last reference on a request path. Most requests release one small
+// object; every kGraphEvery-th request releases a graph of kGraphNodes nodes. With the default
+// policy that request runs the whole destructor chain; with DeferredPolicy it only queues the
+// root and the reclaimer thread destroys the graph.
+
+#include "bench.h"
+
+#include <shared-from-this/deferred.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+constexpr size_t kRequests = 20'000;
+constexpr size_t kGraphEvery = 200;
+constexpr size_t kGraphNodes = 50'000;
+
+template <typename Policy>
+struct Node {
+    int value = 0;
+    std::vector<SharedPtr<Node, Policy>> children;
+};
+
+template <typename Policy>
+SharedPtr<Node<Policy>, Policy> MakeRequest(size_t index) {
+    auto root = MakeShared<Node<Policy>, Policy>();
+    if (index % kGraphEvery == kGraphEvery - 1) {
+        root->children.reserve(kGraphNodes);
+        for (size_t i = 0; i < kGraphNodes; ++i) {
+            root->children.push_back(MakeShared<Node<Policy>, Policy>());
+        }
+    }
+    return root;
+}
+
+template <typename Policy>
+void Measure(const char* name) {
+    std::vector<double> latencies;
+    latencies.reserve(kRequests);
+    for (size_t i = 0; i < kRequests; ++i) {
+        auto request = MakeRequest<Policy>(i);
+        DoNotOptimize(request->value);
+
+        auto start = std::chrono::steady_clock::now();
+        request.Reset();
+        auto finish = std::chrono::steady_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::nano>(finish - start).count());
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        return latencies[static_cast<size_t>(p * static_cast<double>(latencies.size() - 1))];
+    };
+    std::printf("%-40s p50=%8.0f p99=%8.0f p99.9=%10.0f max=%10.0f ns\n", name, percentile(0.5),
+                percentile(0.99), percentile(0.999), latencies.back());
+}
+
+}  // namespace
+
+int main() {
+    Measure<AtomicPolicy>("last Reset(), inline");
+
+    DeferredQueue& queue = DeferredQueue::Global();
+    queue.StartReclaimer();
+    queue.ResetMaxDepth();
+    Measure<DeferredPolicy>("last Reset(), DeferredPolicy");
+    queue.Flush();
+    std::printf("%-40s max depth=%zu destroyed=%llu\n", "reclaimer", queue.MaxDepth(),
+                static_cast<unsigned long long>(queue.DestroyedCount()));
+    queue.StopReclaimer();
+    return 0;
+}
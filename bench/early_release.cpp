@@ -0,0 +1,85 @@
+// Resident memory left behind by large objects that are dead but still have WeakPtrs, as in a
+// cache of weak references. MakeShared releases the pages of objects over
+// `SHARED_EARLY_RELEASE_BYTES` with the last SharedPtr. "warm" first creates and drops one
+// object, which makes glibc serve later ones from the heap instead of mmap.
+
+#include "bench.h"
+
+#include <shared-from-this/shared.h>
+#include <shared-from-this/weak.h>
+
+#include <fstream>
+#include <memory>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr size_t kObjects = 64;
+constexpr size_t kTileBytes = 4 * 1024 * 1024;
+
+template <int kTag>
+struct Tile {
+    unsigned char bytes[kTileBytes];
+};
+
+using ReleasedTile = Tile<0>;
+using KeptTile = Tile<1>;
+
+}  // namespace
+
+template <>
+struct EarlyRelease<KeptTile> : std::false_type {};
+
+namespace {
+
+double ResidentMiB() {
+    size_t pages = 0;
+    size_t resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return static_cast<double>(resident * static_cast<size_t>(sysconf(_SC_PAGESIZE))) /
+           (1024.0 * 1024.0);
+}
+
+// Runs in a child process, so that every run starts from a fresh heap
+template <typename Weak, typename Make>
+void PrintRetained(const char* name, bool warm, Make make) {
+    std::fflush(stdout);
+    if (pid_t child = fork()) {
+        waitpid(child, nullptr, 0);
+        return;
+    }
+
+    if (warm) {
+        make();
+    }
+    double before = ResidentMiB();
+    std::vector<Weak> weak;
+    {
+        std::vector<decltype(make())> strong;
+        for (size_t i = 0; i < kObjects; ++i) {
+            strong.push_back(make());
+            weak.emplace_back(strong.back());
+        }
+        std::printf("%-30s %-5s alive %8.1f MiB", name, warm ? "warm" : "cold",
+                    ResidentMiB() - before);
+    }
+    std::printf("   dead, weakly referenced %8.1f MiB\n", ResidentMiB() - before);
+    std::fflush(stdout);
+    _exit(0);
+}
+
+}  // namespace
+
+int main() {
+    for (bool warm : {false, true}) {
+        PrintRetained<WeakPtr<ReleasedTile>>("MakeShared, EarlyRelease", warm,
+                                             []() { return MakeShared<ReleasedTile>(); });
+        PrintRetained<WeakPtr<KeptTile>>("MakeShared, no EarlyRelease", warm,
+                                         []() { return MakeShared<KeptTile>(); });
+        PrintRetained<std::weak_ptr<KeptTile>>("std::make_shared", warm,
+                                               []() { return std::make_shared<KeptTile>(); });
+    }
+    return 0;
+}
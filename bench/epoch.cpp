@@ -0,0 +1,92 @@
+// Reading one popular object under an epoch guard, or on an online thread that declares a
+// quiescent point every kQuiescentEvery reads, against copying a SharedPtr on every read.
+// A writer replaces the object meanwhile; the last column shows how many retired blocks
+// it kept at most with the default retire bound.
+
+#include "bench.h"
+
+#include <shared-from-this/epoch.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+constexpr size_t kIterations = 1'000'000;
+constexpr size_t kQuiescentEvery = 1'000;
+constexpr int kThreadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+
+double CopyOnRead(const SharedPtr<int>& source, int threads) {
+    double total = MeasureThreads(threads, [&source](int) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            SharedPtr<int> copy = source;
+            DoNotOptimize(*copy);
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+double Guarded(const EpochSharedPtr<int>& source, int threads) {
+    double total = MeasureThreads(threads, [&source](int) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            EpochGuard guard;
+            DoNotOptimize(*source.Get());
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+double Quiescent(const EpochSharedPtr<int>& source, int threads) {
+    double total = MeasureThreads(threads, [&source](int) {
+        EpochDomain& domain = EpochDomain::Global();
+        domain.Online();
+        for (size_t i = 0; i < kIterations; ++i) {
+            DoNotOptimize(*source.Get());
+            if (i % kQuiescentEvery == 0) {
+                domain.Quiescent();
+            }
+        }
+        domain.Offline();
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+// Readers under guards while one extra thread keeps replacing the object
+double WithWriter(EpochSharedPtr<int>& source, int threads, size_t* max_pending) {
+    std::atomic<bool> done = false;
+    double total = MeasureThreads(threads + 1, [&](int index) {
+        if (index == threads) {
+            EpochDomain& domain = EpochDomain::Global();
+            for (int value = 0; !done; ++value) {
+                source.Store(MakeShared<int, EpochPolicy>(value));
+                *max_pending = std::max(*max_pending, domain.Pending());
+            }
+            domain.Synchronize();
+            return;
+        }
+        for (size_t i = 0; i < kIterations; ++i) {
+            EpochGuard guard;
+            DoNotOptimize(*source.Get());
+        }
+        done = true;
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+}  // namespace
+
+int main() {
+    auto shared = MakeShared<int>(42);
+    EpochSharedPtr<int> epoch(MakeShared<int, EpochPolicy>(42));
+
+    for (int threads : kThreadCounts) {
+        PrintRow("SharedPtr copy", threads, CopyOnRead(shared, threads));
+        PrintRow("EpochGuard + Get", threads, Guarded(epoch, threads));
+        PrintRow("Quiescent + Get", threads, Quiescent(epoch, threads));
+
+        size_t max_pending = 0;
+        PrintRow("EpochGuard + Get, writer", threads, WithWriter(epoch, threads, &max_pending));
+        std::printf("%-40s threads=%-3d %10zu blocks\n", "  max retired", threads, max_pending);
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+// One message fanned out to 10k subscriber slots and released again, one thread: a copy and a
+// Reset per subscriber against one ShareN and one ReleaseBatch.
+
+#include "bench.h"
+
+#include <shared-from-this/shared.h>
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+constexpr size_t kSubscribers = 10'000;
+constexpr size_t kRounds = 1'000;
+
+struct Message {
+    char payload[64];
+};
+
+template <typename Policy>
+void Run(const char* policy) {
+    using Ptr = SharedPtr<Message, Policy>;
+    auto message = MakeShared<Message, Policy>();
+    std::vector<Ptr> slots(kSubscribers);
+
+    double copy = 0;
+    double reset = 0;
+    double share_n = 0;
+    double release_batch = 0;
+    for (size_t round = 0; round < kRounds; ++round) {
+        copy += MeasureLoop(1, [&]() {
+            for (auto& slot : slots) {
+                slot = message;
+            }
+        });
+        reset += MeasureLoop(1, [&]() {
+            for (auto& slot : slots) {
+                slot.Reset();
+            }
+        });
+        share_n += MeasureLoop(1, [&]() { message.ShareN(kSubscribers, slots.begin()); });
+        release_batch += MeasureLoop(1, [&]() { Ptr::ReleaseBatch(slots.begin(), slots.end()); });
+    }
+
+    double per_subscriber = static_cast<double>(kRounds * kSubscribers);
+    std::printf("%-22s copy %6.2f  reset %6.2f  ShareN %6.2f  ReleaseBatch %6.2f ns/subscriber\n",
+                policy, copy / per_subscriber, reset / per_subscriber, share_n / per_subscriber,
+                release_batch / per_subscriber);
+}
+
+}  // namespace
+
+int main() {
+    Run<AtomicPolicy>("AtomicPolicy");
+    Run<SingleThreadedPolicy>("SingleThreadedPolicy");
+    return 0;
+}
@@ -0,0 +1,65 @@
+// Resident memory per small shared object, against std::make_shared.
+// Usage: footprint [count...], 10M and 100M objects by default. Every object also costs
+// the 16 bytes of its pointer in the vector that keeps it alive.
+
+#include "bench.h"
+
+#include <shared-from-this/shared.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+size_t ResidentBytes() {
+    size_t pages = 0;
+    size_t resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Runs in a child process, so that memory freed by a previous run is not reused
+template <typename Make>
+void PrintBytesPerObject(const char* name, size_t count, Make make) {
+    std::fflush(stdout);
+    if (pid_t child = fork()) {
+        waitpid(child, nullptr, 0);
+        return;
+    }
+
+    size_t before = ResidentBytes();
+    std::vector<decltype(make())> objects;
+    objects.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        objects.push_back(make());
+    }
+    double bytes = static_cast<double>(ResidentBytes() - before) / static_cast<double>(count);
+    std::printf("%-28s %zu objects %8.2f bytes/object\n", name, count, bytes);
+    std::fflush(stdout);
+    _exit(0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<size_t> counts = {10'000'000, 100'000'000};
+    if (argc > 1) {
+        counts.clear();
+        for (int i = 1; i < argc; ++i) {
+            counts.push_back(std::strtoull(argv[i], nullptr, 10));
+        }
+    }
+
+    std::printf("sizeof(ControlBlockBase)   %zu\n", sizeof(ControlBlockBase));
+    std::printf("sizeof(InlineBlock<int>)   %zu\n", sizeof(InlineBlock<int>));
+    for (size_t count : counts) {
+        PrintBytesPerObject("MakeShared<int>", count, []() { return MakeShared<int>(42); });
+        PrintBytesPerObject("std::make_shared<int>", count,
+                            []() { return std::make_shared<int>(42); });
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+// MakeShared against MakeSharedForOverwrite for large trivial buffers, one thread. Each
+// buffer has only its first byte written, as a producer about to fill it would.
+
+#include "bench.h"
+
+#include <shared-from-this/shared.h>
+
+#include <cstdio>
+
+namespace {
+
+template <size_t Size>
+struct Buffer {
+    unsigned char bytes[Size];
+};
+
+template <size_t Size>
+void Run(const char* name) {
+    constexpr size_t kIterations = 2'000;
+    double zeroed = MeasureLoop(kIterations, []() {
+        auto buffer = MakeShared<Buffer<Size>>();
+        buffer->bytes[0] = 1;
+        DoNotOptimize(buffer);
+    });
+    double overwrite = MeasureLoop(kIterations, []() {
+        auto buffer = MakeSharedForOverwrite<Buffer<Size>>();
+        buffer->bytes[0] = 1;
+        DoNotOptimize(buffer);
+    });
+    std::printf("%-8s MakeShared %10.0f ns/op   MakeSharedForOverwrite %10.0f ns/op\n", name,
+                zeroed, overwrite);
+}
+
+}  // namespace
+
+int main() {
+    Run<64 * 1024>("64 KiB");
+    Run<1024 * 1024>("1 MiB");
+    Run<4 * 1024 * 1024>("4 MiB");
+    return 0;
+}
@@ -0,0 +1,54 @@
+// Reading one popular object through a hazard pointer against copying a SharedPtr
+// on every read, on 1-64 threads
+
+#include "bench.h"
+
+#include <shared-from-this/hazard.h>
+
+namespace {
+
+constexpr size_t kIterations = 1'000'000;
+constexpr int kThreadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+
+double CopyOnRead(const SharedPtr<int>& source, int threads) {
+    double total = MeasureThreads(threads, [&source](int) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            SharedPtr<int> copy = source;
+            DoNotOptimize(*copy);
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+double Protect(const HazardSharedPtr<int>& source, int threads) {
+    double total = MeasureThreads(threads, [&source](int) {
+        HazardPointer hazard;
+        for (size_t i = 0; i < kIterations; ++i) {
+            DoNotOptimize(*hazard.Protect(source));
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+double Load(const HazardSharedPtr<int>& source, int threads) {
+    double total = MeasureThreads(threads, [&source](int) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            DoNotOptimize(*source.Load());
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+}  // namespace
+
+int main() {
+    auto shared = MakeShared<int>(42);
+    HazardSharedPtr<int> hazard(MakeShared<int, HazardPolicy>(42));
+
+    for (int threads : kThreadCounts) {
+        PrintRow("SharedPtr copy", threads, CopyOnRead(shared, threads));
+        PrintRow("HazardPointer::Protect", threads, Protect(hazard, threads));
+        PrintRow("HazardSharedPtr::Load", threads, Load(hazard, threads));
+    }
+    return 0;
+}
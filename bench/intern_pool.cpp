@@ -0,0 +1,151 @@
+// Resident memory of kSymbols symbol references drawn from a Zipf distribution over kDistinct
+// names, stored as copies and as interned pointers. Then InternPool throughput on 1-32 threads:
+// "hit" interns symbols that are already in the pool, "miss" interns symbols nobody holds, so
+// every call allocates a new one and the previous one dies.
+
+#include "bench.h"
+
+#include <shared-from-this/intern_pool.h>
+
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr size_t kIterations = 200'000;
+constexpr size_t kDistinct = 10'000;
+constexpr size_t kSymbols = 2'000'000;
+constexpr int kThreadCounts[] = {1, 2, 4, 8, 16, 32};
+
+struct StringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view value) const {
+        return std::hash<std::string_view>()(value);
+    }
+};
+
+struct StringEqual {
+    using is_transparent = void;
+
+    bool operator()(std::string_view left, std::string_view right) const {
+        return left == right;
+    }
+};
+
+using SymbolPool = InternPool<std::string, StringHash, StringEqual>;
+
+std::vector<std::string> MakeNames(size_t count, const char* prefix) {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < count; ++i) {
+        names.push_back(prefix + std::to_string(i));
+    }
+    return names;
+}
+
+double Hits(int threads) {
+    auto names = MakeNames(kDistinct, "com.example.schema.field_");
+    SymbolPool pool;
+    std::vector<SharedPtr<const std::string>> held;
+    for (const auto& name : names) {
+        held.push_back(pool.Intern(std::string_view(name)));
+    }
+    double total = MeasureThreads(threads, [&pool, &names](int index) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            auto symbol = pool.Intern(std::string_view(names[(i * 7 + index) % kDistinct]));
+            DoNotOptimize(symbol);
+        }
+    });
+    return total / static_cast<double>(kIterations * threads);
+}
+
+double Misses(int threads) {
+    auto names = MakeNames(kDistinct, "com.example.schema.field_");
+    SymbolPool pool;
+    double total = MeasureThreads(threads, [&pool, &names](int index) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            auto symbol = pool.Intern(std::string_view(names[(i * 7 + index) % kDistinct]));
+            DoNotOptimize(symbol);
+        }
+    });
+    return total / static_cast<double>(kIterations * threads);
+}
+
+double ResidentMiB() {
+    size_t pages = 0;
+    size_t resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return static_cast<double>(resident * static_cast<size_t>(sysconf(_SC_PAGESIZE))) /
+           (1024.0 * 1024.0);
+}
+
+// Name ranks with P(rank) ~ 1 / (rank + 1)
+std::vector<size_t> ZipfRanks() {
+    std::vector<double> weights;
+    for (size_t rank = 0; rank < kDistinct; ++rank) {
+        weights.push_back(1.0 / static_cast<double>(rank + 1));
+    }
+    std::discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+    std::mt19937 random(42);
+    std::vector<size_t> ranks(kSymbols);
+    for (size_t& rank : ranks) {
+        rank = zipf(random);
+    }
+    return ranks;
+}
+
+// Runs in a child process, so that every variant starts from a fresh heap. `store` returns the
+// references, which stay alive until they are measured
+template <typename Store>
+void PrintResident(const char* name, Store store) {
+    std::fflush(stdout);
+    if (pid_t child = fork()) {
+        waitpid(child, nullptr, 0);
+        return;
+    }
+
+    auto names = MakeNames(kDistinct, "com.example.schema.descriptor.field_");
+    auto ranks = ZipfRanks();
+    double before = ResidentMiB();
+    auto symbols = store(names, ranks);
+    DoNotOptimize(symbols.data());
+    std::printf("%-40s %8.1f MiB for %zu references\n", name, ResidentMiB() - before, kSymbols);
+    std::fflush(stdout);
+    _exit(0);
+}
+
+}  // namespace
+
+int main() {
+    PrintResident("std::string copies", [](const auto& names, const auto& ranks) {
+        std::vector<std::string> symbols;
+        symbols.reserve(kSymbols);
+        for (size_t rank : ranks) {
+            symbols.push_back(names[rank]);
+        }
+        return symbols;
+    });
+    PrintResident("InternPool SharedPtr<const std::string>", [](const auto& names,
+                                                                 const auto& ranks) {
+        // Kept alive, so that its entries are counted too
+        static SymbolPool pool;
+        std::vector<SharedPtr<const std::string>> symbols;
+        symbols.reserve(kSymbols);
+        for (size_t rank : ranks) {
+            symbols.push_back(pool.Intern(std::string_view(names[rank])));
+        }
+        return symbols;
+    });
+
+    // After the children, which would reuse memory freed here
+    for (int threads : kThreadCounts) {
+        PrintRow("InternPool hit", threads, Hits(threads));
+        PrintRow("InternPool miss", threads, Misses(threads));
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+// WeakPtr::Lock() throughput with many threads probing one weak reference,
+// against std::weak_ptr::lock on 1-64 threads
+
+#include "bench.h"
+
+#include <shared-from-this/shared.h>
+#include <shared-from-this/weak.h>
+
+#include <memory>
+
+namespace {
+
+constexpr size_t kIterations = 1'000'000;
+constexpr int kThreadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+
+template <typename Weak>
+double LockRelease(const Weak& weak, int threads) {
+    double total = MeasureThreads(threads, [&weak](int) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            if constexpr (std::is_same_v<Weak, std::weak_ptr<int>>) {
+                DoNotOptimize(weak.lock());
+            } else {
+                DoNotOptimize(weak.Lock());
+            }
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+}  // namespace
+
+int main() {
+    auto ours = MakeShared<int>(42);
+    auto theirs = std::make_shared<int>(42);
+    WeakPtr<int> our_weak(ours);
+    std::weak_ptr<int> their_weak(theirs);
+
+    for (int threads : kThreadCounts) {
+        PrintRow("WeakPtr::Lock", threads, LockRelease(our_weak, threads));
+        PrintRow("std::weak_ptr::lock", threads, LockRelease(their_weak, threads));
+    }
+    return 0;
+}
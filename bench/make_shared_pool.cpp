@@ -0,0 +1,82 @@
+// MakeShared of a type with `PooledBlocks` against an identical plain one and std::make_shared.
+// "burst" keeps 1000 objects alive before dropping them, so the allocator cannot just hand
+// back the slot it was given last.
+
+#include "bench.h"
+
+#include <shared-from-this/shared.h>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr size_t kIterations = 1'000'000;
+constexpr size_t kBurst = 1'000;
+
+struct Pooled {
+    int id;
+    char payload[20];
+};
+
+struct Plain {
+    int id;
+    char payload[20];
+};
+
+}  // namespace
+
+template <>
+struct PooledBlocks<Pooled> : std::true_type {};
+
+namespace {
+
+template <typename Ptr, typename Make>
+double Churn(int threads, Make make) {
+    double total = MeasureThreads(threads, [make](int) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            Ptr ptr = make();
+            DoNotOptimize(ptr);
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+template <typename Ptr, typename Make>
+double Burst(int threads, Make make) {
+    double total = MeasureThreads(threads, [make](int) {
+        std::vector<Ptr> alive;
+        alive.reserve(kBurst);
+        for (size_t round = 0; round < kIterations / kBurst; ++round) {
+            for (size_t i = 0; i < kBurst; ++i) {
+                alive.push_back(make());
+            }
+            alive.clear();
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+template <typename T>
+void Run(const char* churn, const char* burst) {
+    auto make = []() { return MakeShared<T>(T{1, ""}); };
+    for (int threads : {1, 8}) {
+        PrintRow(churn, threads, Churn<SharedPtr<T>>(threads, make));
+        PrintRow(burst, threads, Burst<SharedPtr<T>>(threads, make));
+    }
+}
+
+}  // namespace
+
+int main() {
+    ReserveShared<Pooled>(8 * kBurst);
+    Run<Pooled>("MakeShared, PooledBlocks", "MakeShared burst, PooledBlocks");
+    Run<Plain>("MakeShared, plain new", "MakeShared burst, plain new");
+
+    auto make = []() { return std::make_shared<Plain>(Plain{1, ""}); };
+    for (int threads : {1, 8}) {
+        PrintRow("std::make_shared", threads, Churn<std::shared_ptr<Plain>>(threads, make));
+        PrintRow("std::make_shared burst", threads, Burst<std::shared_ptr<Plain>>(threads, make));
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+// Code size of 500 distinct element types: build with
+// `g++ -std=c++20 -O2 -DNDEBUG -I. -c bench/many_types.cpp` and compare `size many_types.o`
+
+#include <shared-from-this/shared.h>
+
+#include <cstdio>
+#include <utility>
+
+namespace {
+
+constexpr size_t kTypes = 500;
+
+template <size_t N>
+struct Payload {
+    int values[N % 8 + 1] = {};
+};
+
+template <size_t N>
+size_t Touch() {
+    auto inline_block = MakeShared<Payload<N>>();
+    SharedPtr<Payload<N>> default_block(new Payload<N>);
+    SharedPtr<Payload<N>> copy = inline_block;
+    return copy.UseCount() + default_block.UseCount();
+}
+
+template <size_t... Ns>
+size_t TouchAll(std::index_sequence<Ns...>) {
+    return (Touch<Ns>() + ...);
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%zu\n", TouchAll(std::make_index_sequence<kTypes>()));
+    return 0;
+}
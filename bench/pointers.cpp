@@ -0,0 +1,232 @@
+// Single-threaded hot-path operations of SharedPtr and WeakPtr against std::shared_ptr and
+// std::weak_ptr: ns/op and global operator new calls per op, the best of kRepetitions runs.
+// Usage: pointers [--json], which prints a JSON array instead of the table
+
+#include "allocations.h"
+#include "bench.h"
+
+#include <shared-from-this/shared.h>
+#include <shared-from-this/weak.h>
+
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t kIterations = 1'000'000;
+constexpr int kRepetitions = 5;
+
+struct Base {
+    virtual ~Base() = default;
+
+    int value = 0;
+};
+
+struct Derived : Base {
+    int other = 0;
+};
+
+// Makes `prepare()` fresh state for every run, then times `op(state, i)`. Allocations of
+// `prepare` are not counted
+template <typename Prepare, typename Op>
+BenchResult Measure(const char* name, const char* impl, Prepare prepare, Op op) {
+    BenchResult result{name, impl, 0.0, 0.0};
+    for (int run = 0; run < kRepetitions; ++run) {
+        auto state = prepare();
+        size_t i = 0;
+        size_t before = AllocationCount();
+        double ns = MeasureLoop(kIterations, [&]() { op(state, i++); });
+        double allocations = static_cast<double>(AllocationCount() - before) / kIterations;
+        if (run == 0 || ns < result.ns_per_op) {
+            result.ns_per_op = ns;
+        }
+        result.allocations_per_op = allocations;
+    }
+    return result;
+}
+
+template <typename Op>
+BenchResult Measure(const char* name, const char* impl, Op op) {
+    return Measure(name, impl, [] { return 0; }, [&op](int, size_t) { op(); });
+}
+
+struct Ours {
+    static constexpr const char* kName = "SharedPtr";
+
+    template <typename T>
+    using Shared = SharedPtr<T>;
+    template <typename T>
+    using Weak = WeakPtr<T>;
+
+    template <typename T>
+    static Shared<T> Make() {
+        return MakeShared<T>();
+    }
+
+    template <typename T>
+    static Shared<T> Lock(const Weak<T>& weak) {
+        return weak.Lock();
+    }
+
+    template <typename T, typename... Args>
+    static void Reset(Shared<T>& ptr, Args... args) {
+        ptr.Reset(args...);
+    }
+
+    template <typename T, typename U>
+    static Shared<T> StaticCast(const Shared<U>& ptr) {
+        return Shared<T>(ptr, static_cast<T*>(ptr.Get()));
+    }
+
+    template <typename T, typename U>
+    static Shared<T> DynamicCast(const Shared<U>& ptr) {
+        if (auto* cast = dynamic_cast<T*>(ptr.Get())) {
+            return Shared<T>(ptr, cast);
+        }
+        return Shared<T>();
+    }
+};
+
+struct Std {
+    static constexpr const char* kName = "std::shared_ptr";
+
+    template <typename T>
+    using Shared = std::shared_ptr<T>;
+    template <typename T>
+    using Weak = std::weak_ptr<T>;
+
+    template <typename T>
+    static Shared<T> Make() {
+        return std::make_shared<T>();
+    }
+
+    template <typename T>
+    static Shared<T> Lock(const Weak<T>& weak) {
+        return weak.lock();
+    }
+
+    template <typename T, typename... Args>
+    static void Reset(Shared<T>& ptr, Args... args) {
+        ptr.reset(args...);
+    }
+
+    template <typename T, typename U>
+    static Shared<T> StaticCast(const Shared<U>& ptr) {
+        return std::static_pointer_cast<T>(ptr);
+    }
+
+    template <typename T, typename U>
+    static Shared<T> DynamicCast(const Shared<U>& ptr) {
+        return std::dynamic_pointer_cast<T>(ptr);
+    }
+};
+
+template <typename P>
+std::vector<BenchResult> Suite() {
+    std::vector<BenchResult> results;
+    using Shared = typename P::template Shared<Derived>;
+    using BaseShared = typename P::template Shared<Base>;
+    using Weak = typename P::template Weak<Derived>;
+    const char* impl = P::kName;
+
+    results.push_back(Measure("construct from new, destroy", impl, [] {
+        Shared ptr(new Derived);
+        DoNotOptimize(ptr);
+    }));
+    results.push_back(Measure("MakeShared, destroy", impl, [] {
+        auto ptr = P::template Make<Derived>();
+        DoNotOptimize(ptr);
+    }));
+    results.push_back(Measure(
+        "destroy last owner", impl,
+        [] {
+            std::vector<Shared> owners;
+            owners.reserve(kIterations);
+            for (size_t i = 0; i < kIterations; ++i) {
+                owners.push_back(P::template Make<Derived>());
+            }
+            return owners;
+        },
+        [](auto& owners, size_t i) { P::Reset(owners[i]); }));
+    auto ptr = P::template Make<Derived>();
+    results.push_back(Measure("copy, destroy", impl, [&ptr] {
+        Shared copy = ptr;
+        DoNotOptimize(copy);
+    }));
+    // Alternates between two objects, since std::shared_ptr skips assigning its own owner
+    auto second = P::template Make<Derived>();
+    results.push_back(Measure("copy assign", impl, [&ptr, &second, other = Shared()]() mutable {
+        other = other == ptr ? second : ptr;
+        DoNotOptimize(other);
+    }));
+    results.push_back(Measure("move there and back", impl, [&ptr] {
+        Shared moved = std::move(ptr);
+        DoNotOptimize(moved);
+        ptr = std::move(moved);
+    }));
+    results.push_back(Measure("Reset to a new object", impl, [owner = Shared()]() mutable {
+        P::Reset(owner, new Derived);
+        DoNotOptimize(owner);
+    }));
+    results.push_back(Measure("aliasing construction", impl, [&ptr] {
+        typename P::template Shared<int> member(ptr, &ptr->other);
+        DoNotOptimize(member);
+    }));
+    results.push_back(Measure("upcast construction", impl, [&ptr] {
+        BaseShared base = ptr;
+        DoNotOptimize(base);
+    }));
+    BaseShared base = ptr;
+    results.push_back(Measure("static cast", impl, [&base] {
+        auto derived = P::template StaticCast<Derived>(base);
+        DoNotOptimize(derived);
+    }));
+    results.push_back(Measure("dynamic cast", impl, [&base] {
+        auto derived = P::template DynamicCast<Derived>(base);
+        DoNotOptimize(derived);
+    }));
+    results.push_back(Measure("WeakPtr from SharedPtr", impl, [&ptr] {
+        Weak weak = ptr;
+        DoNotOptimize(weak);
+    }));
+    Weak weak = ptr;
+    results.push_back(Measure("Lock", impl, [&weak] {
+        auto locked = P::Lock(weak);
+        DoNotOptimize(locked);
+    }));
+    Weak expired = P::template Make<Derived>();
+    results.push_back(Measure("Lock expired", impl, [&expired] {
+        auto locked = P::Lock(expired);
+        DoNotOptimize(locked);
+    }));
+    return results;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    bool json = argc > 1 && std::strcmp(argv[1], "--json") == 0;
+
+    // libstdc++ counts without atomics until the process starts its first thread
+    std::thread([] {}).join();
+
+    // Each operation next to its std counterpart
+    auto ours = Suite<Ours>();
+    auto standard = Suite<Std>();
+    std::vector<BenchResult> results;
+    for (size_t i = 0; i < ours.size(); ++i) {
+        results.push_back(ours[i]);
+        results.push_back(standard[i]);
+    }
+
+    if (json) {
+        PrintJson(results);
+    } else {
+        for (const auto& result : results) {
+            PrintResult(result);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+// std::vector against RelocatingVector with 10M SharedPtr<int>, one thread: growth by PushBack
+// from empty, then 100 inserts and 100 erases in the middle. Times are per whole operation.
+
+#include "bench.h"
+
+#include <shared-from-this/relocating_vector.h>
+#include <shared-from-this/shared.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+constexpr size_t kSize = 10'000'000;
+constexpr size_t kMiddleOps = 100;
+
+template <typename F>
+double MeasureMs(F func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(finish - start).count();
+}
+
+template <typename Vector, typename PushBack, typename Insert, typename Erase>
+void Run(const char* name, PushBack push_back, Insert insert, Erase erase) {
+    auto value = MakeShared<int>(42);
+    Vector vector;
+    double grow = MeasureMs([&]() {
+        for (size_t i = 0; i < kSize; ++i) {
+            push_back(vector, value);
+        }
+    });
+    double inserts = MeasureMs([&]() {
+        for (size_t i = 0; i < kMiddleOps; ++i) {
+            insert(vector, kSize / 2, value);
+        }
+    });
+    double erases = MeasureMs([&]() {
+        for (size_t i = 0; i < kMiddleOps; ++i) {
+            erase(vector, kSize / 2);
+        }
+    });
+    std::printf("%-20s grow %8.1f ms   insert %8.2f ms/op   erase %8.2f ms/op\n", name, grow,
+                inserts / kMiddleOps, erases / kMiddleOps);
+}
+
+}  // namespace
+
+int main() {
+    using Ptr = SharedPtr<int>;
+    Run<std::vector<Ptr>>(
+        "std::vector", [](auto& v, const Ptr& p) { v.push_back(p); },
+        [](auto& v, size_t i, const Ptr& p) { v.insert(v.begin() + i, p); },
+        [](auto& v, size_t i) { v.erase(v.begin() + i); });
+    Run<RelocatingVector<Ptr>>(
+        "RelocatingVector", [](auto& v, const Ptr& p) { v.PushBack(p); },
+        [](auto& v, size_t i, const Ptr& p) { v.Insert(v.begin() + i, p); },
+        [](auto& v, size_t i) { v.Erase(v.begin() + i); });
+    return 0;
+}
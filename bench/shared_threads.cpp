@@ -0,0 +1,41 @@
+// Copy/destroy throughput of one pointer shared by many threads
+// against std::shared_ptr on 1-64 threads, plus the single-threaded policy on its owner thread
+
+#include "bench.h"
+
+#include <shared-from-this/shared.h>
+#include <shared-from-this/weak.h>
+
+#include <memory>
+
+namespace {
+
+constexpr size_t kIterations = 1'000'000;
+constexpr int kThreadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+
+template <typename Ptr>
+double CopyDestroy(const Ptr& shared, int threads) {
+    double total = MeasureThreads(threads, [&shared](int) {
+        for (size_t i = 0; i < kIterations; ++i) {
+            Ptr copy(shared);
+            DoNotOptimize(copy);
+        }
+    });
+    return total / static_cast<double>(kIterations);
+}
+
+}  // namespace
+
+int main() {
+    auto ours = MakeShared<int>(42);
+    auto theirs = std::make_shared<int>(42);
+
+    for (int threads : kThreadCounts) {
+        PrintRow("SharedPtr copy+destroy", threads, CopyDestroy(ours, threads));
+        PrintRow("std::shared_ptr copy+destroy", threads, CopyDestroy(theirs, threads));
+    }
+
+    auto local = MakeShared<int, SingleThreadedPolicy>(42);
+    PrintRow("SharedPtr<SingleThreaded> copy+destroy", 1, CopyDestroy(local, 1));
+    return 0;
+}
@@ -0,0 +1,113 @@
+// A side table of sessions keyed by WeakPtr over a simulated day. Every "hour" kInsertsPerHour
+// new sessions replace random live ones and are inserted into the table, and as many lookups hit
+// random live sessions. An unordered_map that never erases keeps every dead session's block,
+// object storage included; WeakKeyedMap sweeps them on insert.
+
+#include "bench.h"
+
+#include <shared-from-this/weak_keyed_map.h>
+
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr size_t kLive = 10'000;
+constexpr size_t kInsertsPerHour = 50'000;
+constexpr int kHours = 24;
+constexpr int kPrintedHours[] = {1, 2, 4, 8, 12, 24};
+
+struct Session {
+    size_t id;
+    char state[248];
+};
+
+using SessionPtr = SharedPtr<Session>;
+
+// The table before this change: entries live until the table is cleared
+class UnsweptMap {
+public:
+    void InsertOrAssign(const SessionPtr& key, size_t value) {
+        map_.insert_or_assign(WeakPtr<Session>(key), value);
+    }
+
+    size_t* Find(const SessionPtr& key) {
+        auto it = map_.find(key);
+        return it == map_.end() ? nullptr : &it->second;
+    }
+
+    size_t Size() const {
+        return map_.size();
+    }
+
+private:
+    std::unordered_map<WeakPtr<Session>, size_t, OwnerHasher, OwnerEqualTo> map_;
+};
+
+double ResidentMiB() {
+    size_t pages = 0;
+    size_t resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return static_cast<double>(resident * static_cast<size_t>(sysconf(_SC_PAGESIZE))) /
+           (1024.0 * 1024.0);
+}
+
+// Runs in a child process, so that every table starts from a fresh heap
+template <typename Map>
+void RunDay(const char* name) {
+    std::fflush(stdout);
+    if (pid_t child = fork()) {
+        waitpid(child, nullptr, 0);
+        return;
+    }
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<size_t> pick(0, kLive - 1);
+    double before = ResidentMiB();
+    Map map;
+    std::vector<SessionPtr> live;
+    for (size_t i = 0; i < kLive; ++i) {
+        live.push_back(MakeShared<Session>(Session{i, {}}));
+        map.InsertOrAssign(live.back(), i);
+    }
+
+    size_t next_id = kLive;
+    for (int hour = 1; hour <= kHours; ++hour) {
+        double lookup_ns = 0;
+        for (size_t i = 0; i < kInsertsPerHour; ++i) {
+            SessionPtr& slot = live[pick(random)];
+            slot = MakeShared<Session>(Session{next_id, {}});
+            map.InsertOrAssign(slot, next_id++);
+
+            const SessionPtr& key = live[pick(random)];
+            auto start = std::chrono::steady_clock::now();
+            size_t* value = map.Find(key);
+            auto finish = std::chrono::steady_clock::now();
+            DoNotOptimize(value);
+            lookup_ns += std::chrono::duration<double, std::nano>(finish - start).count();
+        }
+        for (int printed : kPrintedHours) {
+            if (hour == printed) {
+                std::printf("%-16s hour=%-3d entries=%-8zu lookup %6.1f ns  resident %7.1f MiB\n",
+                            name, hour, map.Size(),
+                            lookup_ns / static_cast<double>(kInsertsPerHour),
+                            ResidentMiB() - before);
+            }
+        }
+    }
+    std::fflush(stdout);
+    _exit(0);
+}
+
+}  // namespace
+
+int main() {
+    RunDay<UnsweptMap>("unordered_map");
+    RunDay<WeakKeyedMap<Session, size_t>>("WeakKeyedMap");
+    return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <atomic>
+
+// Adds one to `*destroyed` when destroyed, on any thread
+struct Counted {
+    Counted(std::atomic<int>* destroyed, int value = 0) : destroyed(destroyed), value(value) {
+    }
+
+    ~Counted() {
+        destroyed->fetch_add(1);
+    }
+
+    std::atomic<int>* destroyed;
+    int value;
+};
@@ -0,0 +1,273 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+
+// Lock-free holder of a `SharedPtr` or `WeakPtr` with split reference counting.
+//
+// The whole state is one 64-bit word: a pointer in the low 48 bits and a local count in the
+// upper 16 bits. Storing a value pre-pays `kPrepaid` references on its control block, and a
+// reader takes one of them with a single `fetch_add` on the word. Once the local count reaches
+// `kRefill`, a reader pays for another batch and moves the local count back down. A writer that
+// swaps the value out returns the references nobody took.
+//
+// While a value is stored, `UseCount()` of its pointers therefore includes up to `kPrepaid`
+// unused references per holder, so it is only exact once no holder has the object. The batch is
+// kept small for that reason, and it bounds the holders of one object to `kMaxHolders`: storing
+// it in more of them at once aborts like any other count overflow.
+//
+// The pointer is normally the control block itself, and the stored `T*` is recovered from
+// `GetRawPtr()`. A value whose `T*` is some other address (aliasing, a base class at a non-zero
+// offset) is kept in a separately allocated `Box`, tagged by the lowest pointer bit.
+template <typename Ptr>
+class AtomicPtrBase {
+    using T = typename Ptr::element_type;
+
+    static constexpr bool kIsWeak = std::is_same_v<Ptr, WeakPtr<T>>;
+
+    static constexpr int kCountShift = 48;
+    static constexpr uintptr_t kOne = uintptr_t{1} << kCountShift;
+    static constexpr uintptr_t kPointerMask = kOne - 1;
+    static constexpr uintptr_t kBoxTag = 1;
+
+    static constexpr size_t kPrepaid = 0x400;
+    static constexpr size_t kRefill = 0x200;
+    // Half of the count range, the rest is left to other owners and refills in flight
+    static constexpr size_t kMaxHolders = ControlBlockBase::kMaxCount / (2 * kPrepaid);
+
+    static_assert(sizeof(uintptr_t) == 8, "AtomicPtrBase needs 64-bit pointers");
+
+    struct alignas(8) Box {
+        std::atomic<size_t> ref_cnt;
+        Ptr value;
+    };
+
+public:
+    AtomicPtrBase() = default;
+
+    AtomicPtrBase(Ptr value) : word_(Pack(std::move(value))) {
+    }
+
+    AtomicPtrBase(const AtomicPtrBase&) = delete;
+    AtomicPtrBase& operator=(const AtomicPtrBase&) = delete;
+
+    ~AtomicPtrBase() {
+        Unpack(word_.load(std::memory_order_relaxed));
+    }
+
+    Ptr Load() const {
+        return Adopt(AcquireTarget());
+    }
+
+    void Store(Ptr desired) {
+        Exchange(std::move(desired));
+    }
+
+    Ptr Exchange(Ptr desired) {
+        return Unpack(word_.exchange(Pack(std::move(desired)), std::memory_order_acq_rel));
+    }
+
+    // Values are equal when they hold the same control block and the same pointer.
+    // On failure `expected` receives the current value
+    bool CompareExchangeStrong(Ptr& expected, Ptr desired) {
+        return CompareExchange(expected, std::move(desired), false);
+    }
+
+    // May fail spuriously, leaving `expected` unchanged
+    bool CompareExchangeWeak(Ptr& expected, Ptr desired) {
+        return CompareExchange(expected, std::move(desired), true);
+    }
+
+    bool IsLockFree() const {
+        return word_.is_lock_free();
+    }
+
+private:
+    mutable std::atomic<uintptr_t> word_ = 0;
+
+    static uintptr_t Target(uintptr_t word) {
+        return word & kPointerMask;
+    }
+
+    static size_t LocalCount(uintptr_t word) {
+        return word >> kCountShift;
+    }
+
+    static bool IsBox(uintptr_t target) {
+        return target & kBoxTag;
+    }
+
+    static Box* AsBox(uintptr_t target) {
+        return reinterpret_cast<Box*>(target & ~kBoxTag);
+    }
+
+    static ControlBlockBase* AsBlock(uintptr_t target) {
+        return reinterpret_cast<ControlBlockBase*>(target);
+    }
+
+    static T* Natural(ControlBlockBase* block) {
+        return static_cast<T*>(block->GetRawPtr());
+    }
+
+    // Returns the new count
+    static size_t AddRefs(uintptr_t target, size_t count) {
+        if (IsBox(target)) {
+            return AsBox(target)->ref_cnt.fetch_add(count, std::memory_order_relaxed) + count;
+        } else if constexpr (kIsWeak) {
+            return AsBlock(target)->IncWeakRef(count);
+        } else {
+            return AsBlock(target)->IncStrongRef(count);
+        }
+    }
+
+    // The stored reference outlives the call, so the count never reaches zero here
+    static void SubRefs(uintptr_t target, size_t count) {
+        if (IsBox(target)) {
+            AsBox(target)->ref_cnt.fetch_sub(count, std::memory_order_relaxed);
+        } else if constexpr (kIsWeak) {
+            AsBlock(target)->DecWeakRef(count);
+        } else {
+            AsBlock(target)->DecStrongRef(count);
+        }
+    }
+
+    static void ReleaseBox(Box* box) {
+        if (box->ref_cnt.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete box;
+        }
+    }
+
+    // Drops a reference taken with `AcquireTarget()` but not turned into a pointer
+    static void ReleaseHeld(uintptr_t target) {
+        if (IsBox(target)) {
+            ReleaseBox(AsBox(target));
+        }
+    }
+
+    // Turns one reference on `target` into a pointer
+    static Ptr Adopt(uintptr_t target) {
+        if (!target) {
+            return Ptr();
+        }
+        if (IsBox(target)) {
+            Box* box = AsBox(target);
+            Ptr result = box->value;
+            ReleaseBox(box);
+            return result;
+        }
+        ControlBlockBase* block = AsBlock(target);
+        return Ptr::Adopt(block, Natural(block));
+    }
+
+    static uintptr_t Pack(Ptr value) {
+        ControlBlockBase* block = value.control_block_;
+        if (!block) {
+            return 0;
+        }
+
+        uintptr_t target;
+        if (static_cast<const void*>(value.ptr_) == block->GetRawPtr()) {
+            value.control_block_ = nullptr;
+            value.ptr_ = nullptr;
+            target = reinterpret_cast<uintptr_t>(block);
+        } else {
+            target = reinterpret_cast<uintptr_t>(new Box{{1}, std::move(value)}) | kBoxTag;
+        }
+        assert(!(target & ~kPointerMask) && "Pointer does not fit into 48 bits");
+        if (AddRefs(target, kPrepaid) / kPrepaid >= kMaxHolders) [[unlikely]] {
+            std::cerr << "Too many AtomicPtrBase holders of one object" << std::endl;
+            std::abort();
+        }
+        return target;
+    }
+
+    // Returns the stored reference of a word that was swapped out
+    static Ptr Unpack(uintptr_t word) {
+        uintptr_t target = Target(word);
+        size_t taken = LocalCount(word);
+        if (target && taken < kPrepaid) {
+            SubRefs(target, kPrepaid - taken);
+        } else if (target && taken > kPrepaid) {
+            // Readers that lost the race to refill took more than the batch
+            AddRefs(target, taken - kPrepaid);
+        }
+        return Adopt(target);
+    }
+
+    // Takes one of the pre-paid references of the stored value
+    uintptr_t AcquireTarget() const {
+        uintptr_t word = word_.fetch_add(kOne, std::memory_order_acquire) + kOne;
+        uintptr_t target = Target(word);
+        if (target && LocalCount(word) >= kRefill) {
+            Refill(word);
+        }
+        return target;
+    }
+
+    void Refill(uintptr_t word) const {
+        uintptr_t target = Target(word);
+        AddRefs(target, kRefill);
+        while (Target(word) == target && LocalCount(word) >= kRefill) {
+            if (word_.compare_exchange_weak(word, word - kRefill * kOne,
+                                            std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        // Another reader has refilled or the value is gone
+        SubRefs(target, kRefill);
+    }
+
+    bool CompareExchange(Ptr& expected, Ptr desired, bool weak) {
+        uintptr_t packed = Pack(std::move(desired));
+        while (true) {
+            // The swap below only compares addresses. A block stays alive through `current`, but
+            // a box must be held until then too, or a new box could reuse its address
+            uintptr_t target = AcquireTarget();
+            Ptr current = IsBox(target) ? AsBox(target)->value : Adopt(target);
+            if (current.control_block_ != expected.control_block_ ||
+                current.ptr_ != expected.ptr_) {
+                ReleaseHeld(target);
+                Unpack(packed);
+                expected = std::move(current);
+                return false;
+            }
+
+            uintptr_t word = word_.load(std::memory_order_relaxed);
+            while (Target(word) == target) {
+                if (word_.compare_exchange_weak(word, packed, std::memory_order_acq_rel,
+                                                std::memory_order_relaxed)) {
+                    Unpack(word);
+                    ReleaseHeld(target);
+                    return true;
+                }
+                if (weak) {
+                    ReleaseHeld(target);
+                    Unpack(packed);
+                    return false;
+                }
+            }
+            ReleaseHeld(target);
+        }
+    }
+};
+
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/atomic2
+template <typename T>
+class AtomicSharedPtr : public AtomicPtrBase<SharedPtr<T>> {
+public:
+    using AtomicPtrBase<SharedPtr<T>>::AtomicPtrBase;
+};
+
+template <typename T>
+class AtomicWeakPtr : public AtomicPtrBase<WeakPtr<T>> {
+public:
+    using AtomicPtrBase<WeakPtr<T>>::AtomicPtrBase;
+};
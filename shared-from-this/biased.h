@@ -0,0 +1,253 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Biased reference counting (Choi, Shull, Torrellas, "Biased Reference Counting", PACT'18).
+//
+// The thread that creates a block owns it: its copies and releases touch a plain `biased`
+// counter. Other threads update the atomic `shared` counter, which may go negative when they
+// release references the owner made. The first time it does, the block is queued to the owner,
+// which merges both counters on its next release of a biased pointer, in
+// `MergeBiasedReferences()` or when it exits. The owner also merges as soon as its own biased
+// count drains to zero; after a merge the block is counted through `shared` only.
+
+struct BiasedBlockBase;
+
+// Per-thread queue of blocks whose shared counter went negative
+class BiasedOwner {
+public:
+    // Owner of the calling thread, created on first use
+    static BiasedOwner* Current() {
+        if (!current) {
+            static thread_local Holder holder;
+            current = holder.owner;
+        }
+        return current;
+    }
+
+    // Same, but never creates one
+    static BiasedOwner* CurrentIfAny() {
+        return current;
+    }
+
+    void Acquire() {
+        ref_cnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Release() {
+        if (ref_cnt_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    bool HasPending() const {
+        return has_pending_.load(std::memory_order_relaxed);
+    }
+
+    // Returns false if the owner thread has already exited
+    bool Enqueue(BiasedBlockBase* block) {
+        std::lock_guard lock(mutex_);
+        if (!alive_) {
+            return false;
+        }
+        queue_.push_back(block);
+        has_pending_.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    void Drain();
+
+private:
+    struct Holder {
+        BiasedOwner* owner;
+
+        Holder() : owner(new BiasedOwner) {
+        }
+
+        ~Holder() {
+            owner->Drain();
+            {
+                std::lock_guard lock(owner->mutex_);
+                owner->alive_ = false;
+            }
+            owner->Drain();
+            current = nullptr;
+            owner->Release();
+        }
+    };
+
+    inline static thread_local BiasedOwner* current = nullptr;
+
+    std::mutex mutex_;
+    std::vector<BiasedBlockBase*> queue_;
+    bool alive_ = true;
+    std::atomic<bool> has_pending_ = false;
+    std::atomic<size_t> ref_cnt_ = 1;
+};
+
+// `shared_ref_cnt` holds the shared counter shifted by two bits, plus two flags. It may go
+// negative, so it cannot share a word with the weak count; the strong half of `ref_cnt` stays 0
+struct BiasedBlockBase : ControlBlockBase {
+    static constexpr size_t kMerged = 1;
+    static constexpr size_t kQueued = 2;
+    static constexpr size_t kOne = 4;
+
+    BiasedOwner* const home = BiasedOwner::Current();
+    std::atomic<size_t> shared_ref_cnt = 0;
+    // Written by the owner thread only, atomic so that `UseCount()` can read it elsewhere
+    std::atomic<size_t> biased_ref_cnt = 0;
+    std::atomic<bool> is_biased = true;
+
+    BiasedBlockBase() {
+        home->Acquire();
+    }
+
+    ~BiasedBlockBase() {
+        home->Release();
+    }
+
+    template <typename Policy>
+    size_t IncStrongRef(size_t count = 1) {
+        if (IsOwnedByCurrentThread()) {
+            size_t result = biased_ref_cnt.load(std::memory_order_relaxed) + count;
+            biased_ref_cnt.store(result, std::memory_order_relaxed);
+            return result;
+        }
+        shared_ref_cnt.fetch_add(count * kOne, std::memory_order_relaxed);
+        return GetStrongCounter();
+    }
+
+    template <typename Policy>
+    bool TryIncStrongRef() {
+        // Remote releases of biased references leave the shared counter negative, so the object
+        // is dead once the sum is 0, even before the merge. The owner goes through the shared
+        // counter too, so that a concurrent remote release fails the compare-exchange
+        size_t current = shared_ref_cnt.load(std::memory_order_acquire);
+        do {
+            if (StrongCount(current) <= 0) {
+                return false;
+            }
+        } while (!shared_ref_cnt.compare_exchange_weak(current, current + kOne,
+                                                       std::memory_order_acquire,
+                                                       std::memory_order_acquire));
+        return true;
+    }
+
+    // Returns 0 when the caller has to destroy the object
+    template <typename Policy>
+    size_t DecStrongRef(size_t count = 1) {
+        BiasedOwner* current = BiasedOwner::CurrentIfAny();
+        if (current == home && current->HasPending()) {
+            // Our reference keeps this block alive through the merge
+            current->Drain();
+        }
+
+        if (IsOwnedByCurrentThread()) {
+            size_t biased = biased_ref_cnt.load(std::memory_order_relaxed);
+            if (count < biased) {
+                biased_ref_cnt.store(biased - count, std::memory_order_relaxed);
+                return biased - count;
+            }
+            // A batch may also hold references that were counted in the shared counter
+            // Merged first: until then `StrongCount()` of other threads adds `biased_ref_cnt`
+            size_t rest = (count - biased) * kOne;
+            size_t old = shared_ref_cnt.fetch_add(kMerged - rest, std::memory_order_acq_rel);
+            biased_ref_cnt.store(0, std::memory_order_relaxed);
+            is_biased.store(false, std::memory_order_relaxed);
+            // A queued block is freed by whoever drains the queue
+            return (old & kQueued) || Count(old - rest) != 0 ? 1 : 0;
+        }
+
+        size_t old = shared_ref_cnt.load(std::memory_order_relaxed);
+        size_t desired;
+        do {
+            desired = old - count * kOne;
+            if (!(old & kMerged) && !(old & kQueued) && Count(desired) < 0) {
+                desired |= kQueued;
+            }
+        } while (!shared_ref_cnt.compare_exchange_weak(old, desired, std::memory_order_acq_rel));
+
+        if ((desired & kQueued) && !(old & kQueued)) {
+            if (!home->Enqueue(this)) {
+                // The owner has exited, so its biased counter will not change anymore
+                MergeQueued();
+            }
+            return 1;
+        }
+        return (desired & kMerged) && !(desired & kQueued) && Count(desired) == 0 ? 0 : 1;
+    }
+
+    size_t GetStrongCounter() const {
+        int64_t count = StrongCount(shared_ref_cnt.load(std::memory_order_relaxed));
+        return count > 0 ? count : 0;
+    }
+
+    // Takes the block out of the owner's queue and merges the counters if still biased
+    void MergeQueued() {
+        size_t old;
+        if (is_biased.load(std::memory_order_relaxed)) {
+            size_t biased = biased_ref_cnt.load(std::memory_order_relaxed);
+            old = shared_ref_cnt.fetch_add(biased * kOne + kMerged - kQueued,
+                                           std::memory_order_acq_rel);
+            old += biased * kOne;
+            is_biased.store(false, std::memory_order_relaxed);
+        } else {
+            old = shared_ref_cnt.fetch_sub(kQueued, std::memory_order_acq_rel);
+        }
+
+        if (Count(old) == 0) {
+            ReleaseObject();
+        }
+    }
+
+private:
+    static int64_t Count(size_t word) {
+        return static_cast<int64_t>(word) >> 2;
+    }
+
+    // Both counters together, `word` being a value of `shared_ref_cnt`. The biased one counts
+    // until the merged flag is set
+    int64_t StrongCount(size_t word) const {
+        int64_t count = Count(word);
+        if (!(word & kMerged)) {
+            count += biased_ref_cnt.load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    bool IsOwnedByCurrentThread() const {
+        return home == BiasedOwner::CurrentIfAny() && is_biased.load(std::memory_order_relaxed);
+    }
+};
+
+inline void BiasedOwner::Drain() {
+    std::vector<BiasedBlockBase*> blocks;
+    {
+        std::lock_guard lock(mutex_);
+        blocks.swap(queue_);
+        has_pending_.store(false, std::memory_order_relaxed);
+    }
+    for (BiasedBlockBase* block : blocks) {
+        block->MergeQueued();
+    }
+}
+
+// Copies and releases on the creating thread skip atomic instructions. Weak counts stay atomic.
+// Not convertible to the other policies and not usable with `EnableSharedFromThis`.
+struct BiasedPolicy : AtomicPolicy {
+    using BlockBase = BiasedBlockBase;
+};
+
+// Merges the blocks released by other threads, so they can be freed without waiting for
+// the next release on this thread
+inline void MergeBiasedReferences() {
+    if (BiasedOwner* owner = BiasedOwner::CurrentIfAny()) {
+        owner->Drain();
+    }
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Fixed-size allocator for control blocks, after the magazine layer of Bonwick and Adams,
+// "Magazines and Vmem", USENIX 2001.
+//
+// Every thread caches two magazines of free slots and allocates from them without locking.
+// When both are empty (or both full on release), it swaps a whole magazine with the global
+// depot under a mutex. A thread that exits hands its magazines to the depot, so blocks freed
+// there are reused by other threads. Slots are carved from slabs that are never returned to
+// the system.
+template <size_t Size>
+class BlockPool {
+public:
+    static constexpr size_t kMagazineSize = 64;
+    static constexpr size_t kSlotSize =
+        (Size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) *
+        alignof(std::max_align_t);
+
+    // Sizes that round up to the same slot share a pool
+    using SizeClass = BlockPool<kSlotSize>;
+
+    static void* Allocate() {
+        Cache* cache = Cache::Current();
+        if (!cache) {
+            return GetDepot().AllocateLoose();
+        }
+        if (cache->loaded->count == 0) {
+            cache->Reload();
+        }
+        return cache->loaded->slots[--cache->loaded->count];
+    }
+
+    static void Deallocate(void* ptr) {
+        Cache* cache = Cache::Current();
+        if (!cache) {
+            GetDepot().DeallocateLoose(ptr);
+            return;
+        }
+        if (cache->loaded->count == kMagazineSize) {
+            cache->Unload();
+        }
+        cache->loaded->slots[cache->loaded->count++] = ptr;
+    }
+
+    // Puts full magazines with at least `count` new slots into the depot, so that the next
+    // `count` allocations on any threads do not touch the system allocator
+    static void Reserve(size_t count) {
+        for (size_t i = 0; i < count; i += kMagazineSize) {
+            auto magazine = new Magazine;
+            Fill(magazine);
+            GetDepot().Return(magazine);
+        }
+    }
+
+    // Slabs taken from the system so far
+    static size_t SlabCount() {
+        return slab_count.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Magazine {
+        size_t count = 0;
+        void* slots[kMagazineSize];
+    };
+
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    inline static std::atomic<size_t> slab_count = 0;
+
+    static char* NewSlab() {
+        slab_count.fetch_add(1, std::memory_order_relaxed);
+        return static_cast<char*>(::operator new(kMagazineSize * kSlotSize));
+    }
+
+    static void Fill(Magazine* magazine) {
+        char* slab = NewSlab();
+        for (size_t i = 0; i < kMagazineSize; ++i) {
+            magazine->slots[i] = slab + i * kSlotSize;
+        }
+        magazine->count = kMagazineSize;
+    }
+
+    class Depot {
+    public:
+        // A magazine with at least one slot, or nullptr
+        Magazine* TakeFull(Magazine* empty) {
+            std::lock_guard lock(mutex_);
+            if (full_.empty()) {
+                return nullptr;
+            }
+            empty_.push_back(empty);
+            Magazine* result = full_.back();
+            full_.pop_back();
+            return result;
+        }
+
+        // An empty magazine in exchange for a full one
+        Magazine* TakeEmpty(Magazine* full) {
+            std::lock_guard lock(mutex_);
+            full_.push_back(full);
+            if (empty_.empty()) {
+                return new Magazine;
+            }
+            Magazine* result = empty_.back();
+            empty_.pop_back();
+            return result;
+        }
+
+        void Return(Magazine* magazine) {
+            std::lock_guard lock(mutex_);
+            (magazine->count ? full_ : empty_).push_back(magazine);
+        }
+
+        // Slow path for threads whose cache is already gone
+        void* AllocateLoose() {
+            std::lock_guard lock(mutex_);
+            if (!loose_) {
+                FillLoose();
+            }
+            return std::exchange(loose_, loose_->next);
+        }
+
+        void DeallocateLoose(void* ptr) {
+            std::lock_guard lock(mutex_);
+            loose_ = new (ptr) FreeSlot{loose_};
+        }
+
+    private:
+        std::mutex mutex_;
+        std::vector<Magazine*> full_;
+        std::vector<Magazine*> empty_;
+        FreeSlot* loose_ = nullptr;
+
+        void FillLoose() {
+            char* slab = NewSlab();
+            for (size_t i = 0; i < kMagazineSize; ++i) {
+                loose_ = new (slab + i * kSlotSize) FreeSlot{loose_};
+            }
+        }
+    };
+
+    class Cache {
+    public:
+        // Never created again once the thread has started to exit
+        static Cache* Current() {
+            if (!current && !exited) {
+                static thread_local Cache cache;
+                current = &cache;
+            }
+            return current;
+        }
+
+        Magazine* loaded = new Magazine;
+        Magazine* previous = new Magazine;
+
+        ~Cache() {
+            current = nullptr;
+            exited = true;
+            GetDepot().Return(loaded);
+            GetDepot().Return(previous);
+        }
+
+        void Reload() {
+            if (previous->count > 0) {
+                std::swap(loaded, previous);
+            } else if (Magazine* full = GetDepot().TakeFull(loaded)) {
+                loaded = full;
+            } else {
+                Fill(loaded);
+            }
+        }
+
+        void Unload() {
+            if (previous->count == 0) {
+                std::swap(loaded, previous);
+            } else {
+                Magazine* empty = GetDepot().TakeEmpty(previous);
+                previous = loaded;
+                loaded = empty;
+            }
+        }
+
+    private:
+        inline static thread_local Cache* current = nullptr;
+        inline static thread_local bool exited = false;
+    };
+
+    // Outlives every thread and every static object that may still free a block
+    static Depot& GetDepot() {
+        static Depot* depot = new Depot;
+        return *depot;
+    }
+};
+
+// The pool shared by all objects of the size class of `T`
+template <typename T>
+using SizeClassPool = typename BlockPool<sizeof(T)>::SizeClass;
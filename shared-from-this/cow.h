@@ -0,0 +1,115 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <utility>
+
+// A value with copy-on-write semantics. Copies share one immutable object; the first mutable
+// access through a copy that is not the only one clones the object, otherwise it is mutated in
+// place. Reads never copy or touch the count.
+//
+// The object is created by the `Cow` or handed over as a `SharedPtr<T>`, so it is never a const
+// object. Its users must not keep other pointers to it, or they see mutations in place
+template <typename T, typename Policy = AtomicPolicy>
+class Cow {
+public:
+    // Several writes with one uniqueness check, see `Cow::Mutate`. Valid until the `Cow` is
+    // copied, assigned or destroyed
+    class Mutation {
+        friend class Cow;
+
+    public:
+        T& operator*() const {
+            return *value_;
+        }
+
+        T* operator->() const {
+            return value_;
+        }
+
+    private:
+        T* value_;
+
+        explicit Mutation(T* value) : value_(value) {
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    Cow() requires std::is_default_constructible_v<T> : ptr_(MakeShared<T, Policy>()) {
+    }
+
+    Cow(const T& value) : ptr_(MakeShared<T, Policy>(value)) {
+    }
+
+    Cow(T&& value) : ptr_(MakeShared<T, Policy>(std::move(value))) {
+    }
+
+    template <typename... Args>
+    explicit Cow(std::in_place_t, Args&&... args)
+        : ptr_(MakeShared<T, Policy>(std::forward<Args>(args)...)) {
+    }
+
+    // Takes over the object of `ptr`, which must not be empty
+    explicit Cow(SharedPtr<T, Policy> ptr) : ptr_(std::move(ptr)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    const T& operator*() const {
+        return *ptr_;
+    }
+
+    const T* operator->() const {
+        return ptr_.Get();
+    }
+
+    const T& Read() const {
+        return *ptr_;
+    }
+
+    // The shared object, e.g. to hand it to code that takes `SharedPtr<const T>`
+    const SharedPtr<const T, Policy>& Share() const {
+        return ptr_;
+    }
+
+    // Whether the next write mutates in place
+    bool IsUnique() const {
+        return ptr_.UseCount() == 1;
+    }
+
+    size_t UseCount() const {
+        return ptr_.UseCount();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // The object to mutate, cloned first if another `Cow` shares it
+    T& Write() {
+        if (IsUnique()) {
+            // Pairs with the release of the last other owner, so that its reads happen before
+            // the writes
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } else {
+            ptr_ = MakeShared<T, Policy>(*ptr_);
+        }
+        return const_cast<T&>(*ptr_);
+    }
+
+    Mutation Mutate() {
+        return Mutation(&Write());
+    }
+
+    // Runs `func(T&)` on the object to mutate and returns what it returns
+    template <typename F>
+    decltype(auto) Mutate(F&& func) {
+        return std::forward<F>(func)(Write());
+    }
+
+private:
+    SharedPtr<const T, Policy> ptr_;
+};
@@ -0,0 +1,313 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+// Synchronous cycle collection by trial deletion (Bacon and Rajan, "Concurrent Cycle Collection
+// in Reference Counted Systems", ECOOP 2001).
+//
+// A strong release of a `CyclePolicy` block that leaves the count above zero may have dropped
+// the last outside reference to a cycle, so the block is buffered as a candidate root.
+// `CollectCycles()` marks the subgraph reachable from the candidates gray and counts the
+// references it holds to itself. A gray object with more references than that is live, and so
+// is everything it reaches; the other gray objects are garbage. Their edges to each other are
+// reset, which destroys them, so their destructors see those edges empty.
+//
+// Counts are updated as with `SingleThreadedPolicy`: a graph and its collector belong to one
+// thread, e.g. an event loop.
+
+// Specialize with `template <typename Visitor> static void ForEach(T& object, Visitor& visit)`
+// that calls `visit(edge)` once for every `SharedPtr<U, CyclePolicy>` that `object` owns. Objects
+// of other types are leaves. An edge left out only keeps garbage alive; an edge visited twice may
+// destroy a live object
+template <typename T>
+struct CycleEdges {};
+
+class CycleEdgeVisitor;
+
+template <typename T>
+concept HasCycleEdges = requires(T& object, CycleEdgeVisitor& visit) {
+    CycleEdges<T>::ForEach(object, visit);
+};
+
+struct CycleBlockBase : ControlBlockBase {
+    enum class Color : uint8_t {
+        kBlack,   // In use
+        kPurple,  // Candidate root
+        kGray,    // Under trial deletion
+        kWhite,   // Garbage
+    };
+
+    using Tracer = void (*)(void* object, CycleEdgeVisitor& visit);
+
+    // Null for objects without `CycleEdges`, which are never candidates
+    Tracer trace = nullptr;
+    // References from gray objects during a collection
+    uint32_t internal = 0;
+    Color color = Color::kBlack;
+    // A buffered block holds a weak reference, so that it outlives its object
+    bool buffered = false;
+
+    template <typename Policy>
+    size_t DecStrongRef(size_t count = 1);
+
+    template <typename Y>
+    void TrackObject(Y*) {
+        using Object = std::remove_cv_t<Y>;
+        if constexpr (HasCycleEdges<Object>) {
+            if (!trace) {
+                trace = &Trace<Object>;
+            }
+        }
+    }
+
+    void TraceEdges(CycleEdgeVisitor& visit) {
+        if (trace) {
+            trace(GetRawPtr(), visit);
+        }
+    }
+
+private:
+    template <typename T>
+    static void Trace(void* object, CycleEdgeVisitor& visit) {
+        CycleEdges<T>::ForEach(*static_cast<T*>(object), visit);
+    }
+};
+
+struct CyclePolicy : SingleThreadedPolicy {
+    using BlockBase = CycleBlockBase;
+};
+
+// Passed to `CycleEdges<T>::ForEach`
+class CycleEdgeVisitor {
+    friend class CycleCollector;
+
+    using Color = CycleBlockBase::Color;
+
+public:
+    template <typename U>
+    void operator()(SharedPtr<U, CyclePolicy>& edge) {
+        CycleBlockBase* child = edge.control_block_;
+        if (!child) {
+            return;
+        }
+        switch (mode_) {
+            case Mode::kMarkGray:
+                ++child->internal;
+                if (child->color != Color::kGray) {
+                    child->color = Color::kGray;
+                    visited_->push_back(child);
+                    stack_->push_back(child);
+                }
+                break;
+            case Mode::kScanBlack:
+                if (child->color == Color::kGray) {
+                    child->color = Color::kBlack;
+                    stack_->push_back(child);
+                }
+                break;
+            case Mode::kClearWhite:
+                if (child->color == Color::kWhite) {
+                    edge.Reset();
+                }
+                break;
+        }
+    }
+
+private:
+    enum class Mode {
+        kMarkGray,
+        kScanBlack,
+        kClearWhite,
+    };
+
+    Mode mode_;
+    std::vector<CycleBlockBase*>* visited_;
+    std::vector<CycleBlockBase*>* stack_;
+
+    CycleEdgeVisitor(Mode mode, std::vector<CycleBlockBase*>* visited,
+                     std::vector<CycleBlockBase*>* stack)
+        : mode_(mode), visited_(visited), stack_(stack) {
+    }
+};
+
+// One per thread. Candidates still buffered when the thread exits are not collected
+class CycleCollector {
+    using Color = CycleBlockBase::Color;
+    using Mode = CycleEdgeVisitor::Mode;
+
+public:
+    // Never created again once the thread has started to exit
+    static CycleCollector* Current() {
+        if (!current && !exited) {
+            static thread_local CycleCollector collector;
+            current = &collector;
+        }
+        return current;
+    }
+
+    CycleCollector(const CycleCollector&) = delete;
+    CycleCollector& operator=(const CycleCollector&) = delete;
+
+    ~CycleCollector() {
+        current = nullptr;
+        exited = true;
+        for (CycleBlockBase* root : roots_) {
+            root->color = Color::kBlack;
+            Unbuffer(root);
+        }
+    }
+
+    void PossibleRoot(CycleBlockBase* block) {
+        if (block->color != Color::kBlack) {
+            return;
+        }
+        block->color = Color::kPurple;
+        if (!block->buffered) {
+            block->buffered = true;
+            block->IncWeakRef<CyclePolicy>();
+            roots_.push_back(block);
+        }
+    }
+
+    // Trial deletion from at most `max_roots` of the newest candidates; the others stay
+    // buffered for the next call. The pause grows with the subgraph reachable from them.
+    // Returns the number of objects destroyed. A no-op when called from one of those destructors
+    size_t CollectCycles(size_t max_roots = std::numeric_limits<size_t>::max()) {
+        if (collecting_ || roots_.empty()) {
+            return 0;
+        }
+        collecting_ = true;
+
+        size_t count = std::min(max_roots, roots_.size());
+        std::vector<CycleBlockBase*> roots(roots_.end() - count, roots_.end());
+        roots_.resize(roots_.size() - count);
+
+        std::vector<CycleBlockBase*> visited;
+        MarkRoots(roots, &visited);
+        ScanRoots(visited);
+
+        std::vector<CycleBlockBase*> garbage;
+        for (CycleBlockBase* block : visited) {
+            block->internal = 0;
+            if (block->color == Color::kGray) {
+                block->color = Color::kWhite;
+                garbage.push_back(block);
+            }
+        }
+        // Before any destructor runs, so that the roots it releases are buffered again
+        for (CycleBlockBase* root : roots) {
+            if (root->color != Color::kWhite) {
+                root->color = Color::kBlack;
+            }
+            Unbuffer(root);
+        }
+        CollectWhite(garbage);
+
+        collecting_ = false;
+        return garbage.size();
+    }
+
+    size_t CandidateCount() const {
+        return roots_.size();
+    }
+
+private:
+    inline static thread_local CycleCollector* current = nullptr;
+    inline static thread_local bool exited = false;
+
+    std::vector<CycleBlockBase*> roots_;
+    bool collecting_ = false;
+
+    CycleCollector() = default;
+
+    // Grays everything reachable from the live candidates and counts their internal references
+    static void MarkRoots(const std::vector<CycleBlockBase*>& roots,
+                          std::vector<CycleBlockBase*>* visited) {
+        std::vector<CycleBlockBase*> stack;
+        CycleEdgeVisitor visit(Mode::kMarkGray, visited, &stack);
+        for (CycleBlockBase* root : roots) {
+            // A root whose object is gone has no edges, and no edge leads to it
+            if (root->color != Color::kPurple || root->GetStrongCounter() == 0) {
+                continue;
+            }
+            root->color = Color::kGray;
+            visited->push_back(root);
+            stack.push_back(root);
+            while (!stack.empty()) {
+                CycleBlockBase* block = stack.back();
+                stack.pop_back();
+                block->TraceEdges(visit);
+            }
+        }
+    }
+
+    // Blackens every gray object referenced from outside the gray subgraph, and all it reaches
+    static void ScanRoots(const std::vector<CycleBlockBase*>& visited) {
+        std::vector<CycleBlockBase*> stack;
+        CycleEdgeVisitor visit(Mode::kScanBlack, nullptr, &stack);
+        for (CycleBlockBase* block : visited) {
+            if (block->color != Color::kGray || block->GetStrongCounter() == block->internal) {
+                continue;
+            }
+            block->color = Color::kBlack;
+            stack.push_back(block);
+            while (!stack.empty()) {
+                CycleBlockBase* reached = stack.back();
+                stack.pop_back();
+                reached->TraceEdges(visit);
+            }
+        }
+    }
+
+    // Every reference to a white object comes from a white object. The collector holds one
+    // reference to each while their edges to each other are reset, then drops it
+    static void CollectWhite(const std::vector<CycleBlockBase*>& garbage) {
+        for (CycleBlockBase* block : garbage) {
+            block->IncStrongRef<CyclePolicy>();
+        }
+        CycleEdgeVisitor visit(Mode::kClearWhite, nullptr, nullptr);
+        for (CycleBlockBase* block : garbage) {
+            block->TraceEdges(visit);
+        }
+        for (CycleBlockBase* block : garbage) {
+            block->color = Color::kBlack;
+            if (block->DecStrongRef<CyclePolicy>() == 0) {
+                block->ReleaseObject<CyclePolicy>();
+            } else {
+                assert(false && "CycleEdges<T> visited an edge more than once");
+            }
+        }
+    }
+
+    static void Unbuffer(CycleBlockBase* block) {
+        block->buffered = false;
+        if (block->DecWeakRef<CyclePolicy>() == 0) {
+            block->Delete();
+        }
+    }
+};
+
+template <typename Policy>
+size_t CycleBlockBase::DecStrongRef(size_t count) {
+    size_t result = ControlBlockBase::DecStrongRef<Policy>(count);
+    if (result > 0 && trace) {
+        if (CycleCollector* collector = CycleCollector::Current()) {
+            collector->PossibleRoot(this);
+        }
+    }
+    return result;
+}
+
+// Collects the cycles among the calling thread's candidates, see `CycleCollector`
+inline size_t CollectCycles(size_t max_roots = std::numeric_limits<size_t>::max()) {
+    CycleCollector* collector = CycleCollector::Current();
+    return collector ? collector->CollectCycles(max_roots) : 0;
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// Deferred destruction. When the last strong reference of a `DeferredPolicy` block is dropped,
+// the block is pushed onto a lock-free stack instead of destroying the object, so the releasing
+// thread pays for one `compare_exchange` and not for the destructor chain of a large object
+// graph. A background reclaimer, or whoever calls `Drain()`, destroys the queued objects in the
+// order in which they were released.
+//
+// Without a running reclaimer, queued objects wait for `Drain()`.
+
+struct DeferredBlockBase;
+
+class DeferredQueue {
+public:
+    // Never destroyed, so that blocks can be released by static destructors at exit. Call
+    // `StopReclaimer()` at shutdown to destroy what is left
+    static DeferredQueue& Global() {
+        static DeferredQueue* queue = new DeferredQueue;
+        return *queue;
+    }
+
+    DeferredQueue() = default;
+
+    DeferredQueue(const DeferredQueue&) = delete;
+    DeferredQueue& operator=(const DeferredQueue&) = delete;
+
+    ~DeferredQueue() {
+        StopReclaimer();
+    }
+
+    // Lock-free. Wakes the reclaimer if the stack was empty
+    void Push(DeferredBlockBase* block);
+
+    // Destroys every queued object on the calling thread, including objects released by those
+    // destructors, after waiting for a batch the reclaimer may be destroying. Returns the number
+    // of objects destroyed by this call. Must not be called from a destructor it runs
+    size_t Drain();
+
+    // Returns once every object released before the call has been destroyed, by the reclaimer if
+    // it runs and by the calling thread otherwise
+    void Flush() {
+        while (IsReclaimerRunning()) {
+            {
+                std::lock_guard lock(drain_mutex_);
+                if (!head_.load(std::memory_order_acquire)) {
+                    return;
+                }
+            }
+            Wake();
+            std::this_thread::yield();
+        }
+        Drain();
+    }
+
+    void StartReclaimer() {
+        std::lock_guard lock(reclaimer_mutex_);
+        if (!reclaimer_.joinable()) {
+            stopping_.store(false, std::memory_order_relaxed);
+            reclaimer_ = std::thread([this]() { RunReclaimer(); });
+            running_.store(true, std::memory_order_release);
+        }
+    }
+
+    // Joins the reclaimer and destroys what is left
+    void StopReclaimer() {
+        {
+            std::lock_guard lock(reclaimer_mutex_);
+            if (reclaimer_.joinable()) {
+                stopping_.store(true, std::memory_order_relaxed);
+                Wake();
+                reclaimer_.join();
+                running_.store(false, std::memory_order_release);
+            }
+        }
+        Drain();
+    }
+
+    bool IsReclaimerRunning() const {
+        return running_.load(std::memory_order_acquire);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Metrics, all relaxed
+
+    // Released but not yet destroyed
+    size_t Depth() const {
+        return depth_.load(std::memory_order_relaxed);
+    }
+
+    // The largest `Depth()` seen since the last `ResetMaxDepth()`
+    size_t MaxDepth() const {
+        return max_depth_.load(std::memory_order_relaxed);
+    }
+
+    void ResetMaxDepth() {
+        max_depth_.store(Depth(), std::memory_order_relaxed);
+    }
+
+    uint64_t PushedCount() const {
+        return pushed_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t DestroyedCount() const {
+        return destroyed_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<DeferredBlockBase*> head_ = nullptr;
+    // Bumped when work arrives or the reclaimer is stopped, see `RunReclaimer()`
+    std::atomic<uint32_t> signal_ = 0;
+
+    std::atomic<size_t> depth_ = 0;
+    std::atomic<size_t> max_depth_ = 0;
+    std::atomic<uint64_t> pushed_ = 0;
+    std::atomic<uint64_t> destroyed_ = 0;
+
+    // Held while a batch is destroyed
+    std::mutex drain_mutex_;
+
+    std::mutex reclaimer_mutex_;
+    std::thread reclaimer_;
+    std::atomic<bool> stopping_ = false;
+    std::atomic<bool> running_ = false;
+
+    void Wake() {
+        signal_.fetch_add(1, std::memory_order_release);
+        signal_.notify_one();
+    }
+
+    void RunReclaimer() {
+        while (true) {
+            uint32_t seen = signal_.load(std::memory_order_acquire);
+            Drain();
+            if (stopping_.load(std::memory_order_relaxed)) {
+                return;
+            }
+            if (!head_.load(std::memory_order_acquire)) {
+                signal_.wait(seen, std::memory_order_acquire);
+            }
+        }
+    }
+
+    static void Free(DeferredBlockBase* block);
+};
+
+struct DeferredBlockBase : ControlBlockBase {
+    DeferredBlockBase* deferred_next = nullptr;
+
+    // The last release queues the block, so the caller never destroys it
+    template <typename Policy>
+    size_t DecStrongRef(size_t count = 1) {
+        size_t result = ControlBlockBase::DecStrongRef<Policy>(count);
+        if (result == 0) {
+            DeferredQueue::Global().Push(this);
+            return 1;
+        }
+        return result;
+    }
+};
+
+inline void DeferredQueue::Push(DeferredBlockBase* block) {
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+    size_t depth = depth_.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t max_depth = max_depth_.load(std::memory_order_relaxed);
+    while (depth > max_depth &&
+           !max_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {
+    }
+
+    // The block may be drained as soon as it is published, so only `head` is read afterwards
+    DeferredBlockBase* head = head_.load(std::memory_order_relaxed);
+    do {
+        block->deferred_next = head;
+    } while (!head_.compare_exchange_weak(head, block, std::memory_order_release,
+                                          std::memory_order_relaxed));
+    if (!head) {
+        Wake();
+    }
+}
+
+inline void DeferredQueue::Free(DeferredBlockBase* block) {
+    block->ReleaseObject();
+}
+
+inline size_t DeferredQueue::Drain() {
+    std::lock_guard lock(drain_mutex_);
+    size_t destroyed = 0;
+    // Taking the whole stack at once leaves no room for ABA
+    while (DeferredBlockBase* batch = head_.exchange(nullptr, std::memory_order_acquire)) {
+        DeferredBlockBase* oldest_first = nullptr;
+        while (batch) {
+            DeferredBlockBase* next = batch->deferred_next;
+            batch->deferred_next = oldest_first;
+            oldest_first = batch;
+            batch = next;
+        }
+        while (oldest_first) {
+            DeferredBlockBase* next = oldest_first->deferred_next;
+            depth_.fetch_sub(1, std::memory_order_relaxed);
+            Free(oldest_first);
+            oldest_first = next;
+            ++destroyed;
+            destroyed_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return destroyed;
+}
+
+// Atomic pointers count as usual; a strong release that drops the count to zero queues the
+// block to `DeferredQueue::Global()`. Pick it per pointer type, e.g.
+// `using GraphPtr = SharedPtr<Graph, DeferredPolicy>`. Not convertible to the other policies and
+// not usable with `EnableSharedFromThis`.
+struct DeferredPolicy : AtomicPolicy {
+    using BlockBase = DeferredBlockBase;
+};
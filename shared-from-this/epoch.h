@@ -0,0 +1,386 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Epoch-based reclamation (Fraser, "Practical lock-freedom", 2004) and its quiescent-state
+// variant (McKenney, Slingwine, "Read-copy update", 1998).
+//
+// A reader announces the global epoch it has seen and may then use any object reachable from
+// an `EpochSharedPtr` through a raw pointer. When the last strong reference of an `EpochPolicy`
+// block is dropped, the block is retired with the current epoch instead of being destroyed.
+// The epoch advances only after every reader has announced the current one, so a block retired
+// in epoch `e` is destroyed once the global epoch reaches `e + 2`.
+//
+// Readers either enter an `EpochGuard` around each read, or stay online and call
+// `EpochDomain::Quiescent()` at points where they hold no raw pointers. The latter reads with
+// no synchronization at all.
+
+struct EpochBlockBase;
+
+struct EpochRecord {
+    // `epoch << 1 | kActive` while the thread is reading, 0 otherwise
+    std::atomic<uint64_t> state = 0;
+    std::atomic<bool> in_use = false;
+    EpochRecord* next = nullptr;
+};
+
+class EpochDomain {
+public:
+    static constexpr uint64_t kActive = 1;
+    static constexpr size_t kDefaultScanThreshold = 64;
+    static constexpr size_t kDefaultRetireBound = 4096;
+
+    static EpochDomain& Global() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    EpochDomain() = default;
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // No reader is left at this point
+    ~EpochDomain();
+
+    // Guards nest, and do nothing on an online thread
+    void Enter() {
+        ThreadState& local = Local();
+        if (local.nesting++ == 0 && !local.online) {
+            Announce(local);
+        }
+    }
+
+    void Exit() {
+        ThreadState& local = Local();
+        assert(local.nesting > 0 && "Exit without Enter");
+        if (--local.nesting == 0 && !local.online) {
+            local.record->state.store(0, std::memory_order_release);
+        }
+    }
+
+    // QSBR: an online thread is always reading, except at the quiescent points it declares
+    void Online() {
+        ThreadState& local = Local();
+        assert(!local.online && "Thread is already online");
+        local.online = true;
+        Announce(local);
+    }
+
+    void Offline() {
+        ThreadState& local = Local();
+        assert(local.online && local.nesting == 0 && "Thread is not online or inside a guard");
+        local.online = false;
+        local.record->state.store(0, std::memory_order_release);
+    }
+
+    // Raw pointers read before this point must not be used after it
+    void Quiescent() {
+        ThreadState& local = Local();
+        assert(local.online && local.nesting == 0 && "Thread is not online or inside a guard");
+        Announce(local);
+        if (local.retired.size() >= ScanThreshold()) {
+            TryAdvance();
+            Collect();
+        }
+    }
+
+    bool IsReading() const {
+        ThreadState& local = Local();
+        return local.online || local.nesting > 0;
+    }
+
+    void Retire(EpochBlockBase* block) {
+        ThreadState& local = Local();
+        local.retired.push_back({block, epoch_.load(std::memory_order_seq_cst)});
+        if (local.retired.size() < ScanThreshold()) {
+            return;
+        }
+        TryAdvance();
+        Collect();
+        // A reading thread would wait for itself
+        if (local.retired.size() >= RetireBound() && !IsReading()) {
+            Synchronize();
+        }
+    }
+
+    // Waits until everything retired by the calling thread and by exited threads is destroyed.
+    // Must not be called while reading
+    void Synchronize() {
+        assert(!IsReading() && "Synchronize would wait for the calling thread");
+        ThreadState& local = Local();
+        Collect();
+        while (!local.retired.empty()) {
+            if (!TryAdvance()) {
+                std::this_thread::yield();
+            }
+            Collect();
+        }
+    }
+
+    // Blocks retired by the calling thread and not destroyed yet
+    size_t Pending() const {
+        return Local().retired.size();
+    }
+
+    uint64_t Epoch() const {
+        return epoch_.load(std::memory_order_relaxed);
+    }
+
+    // A thread tries to advance the epoch once it has retired this many blocks
+    void SetScanThreshold(size_t threshold) {
+        scan_threshold_.store(threshold, std::memory_order_relaxed);
+    }
+
+    size_t ScanThreshold() const {
+        return scan_threshold_.load(std::memory_order_relaxed);
+    }
+
+    // A thread that is not reading waits for reclamation rather than keep more than this many
+    // retired blocks. Readers that never leave their guard still hold back every thread
+    void SetRetireBound(size_t bound) {
+        retire_bound_.store(bound, std::memory_order_relaxed);
+    }
+
+    size_t RetireBound() const {
+        return std::max(retire_bound_.load(std::memory_order_relaxed), ScanThreshold());
+    }
+
+private:
+    struct Retired {
+        EpochBlockBase* block;
+        uint64_t epoch;
+    };
+
+    // Blocks left over at thread exit are handed to the domain
+    struct ThreadState {
+        EpochRecord* record = Global().AcquireRecord();
+        size_t nesting = 0;
+        bool online = false;
+        std::vector<Retired> retired;
+
+        ~ThreadState();
+    };
+
+    static ThreadState& Local() {
+        static thread_local ThreadState state;
+        return state;
+    }
+
+    // Records are reused but never freed while the domain is alive
+    EpochRecord* AcquireRecord() {
+        for (EpochRecord* record = head_.load(std::memory_order_acquire); record;
+             record = record->next) {
+            if (!record->in_use.load(std::memory_order_relaxed) &&
+                !record->in_use.exchange(true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+
+        auto record = new EpochRecord;
+        record->in_use.store(true, std::memory_order_relaxed);
+        record->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+        return record;
+    }
+
+    // A stale epoch only holds the next advance back, so it is safe to announce
+    void Announce(ThreadState& local) {
+        uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+        local.record->state.store(epoch << 1 | kActive, std::memory_order_seq_cst);
+    }
+
+    bool TryAdvance() {
+        uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+        for (EpochRecord* record = head_.load(std::memory_order_acquire); record;
+             record = record->next) {
+            uint64_t state = record->state.load(std::memory_order_seq_cst);
+            if ((state & kActive) && (state >> 1) != epoch) {
+                return false;
+            }
+        }
+        epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+        return true;
+    }
+
+    static void Free(EpochBlockBase* block);
+
+    void Collect();
+
+    std::atomic<uint64_t> epoch_ = 0;
+    std::atomic<EpochRecord*> head_ = nullptr;
+    std::atomic<size_t> scan_threshold_ = kDefaultScanThreshold;
+    std::atomic<size_t> retire_bound_ = kDefaultRetireBound;
+
+    std::mutex mutex_;
+    std::vector<Retired> orphans_;
+};
+
+struct EpochBlockBase : ControlBlockBase {
+    // The last release retires the block, so the caller never destroys it
+    template <typename Policy>
+    size_t DecStrongRef(size_t count = 1) {
+        size_t result = ControlBlockBase::DecStrongRef<Policy>(count);
+        if (result == 0) {
+            EpochDomain::Global().Retire(this);
+            return 1;
+        }
+        return result;
+    }
+};
+
+inline void EpochDomain::Free(EpochBlockBase* block) {
+    block->ReleaseObject();
+}
+
+inline void EpochDomain::Collect() {
+    std::vector<Retired> retired;
+    retired.swap(Local().retired);
+    {
+        std::lock_guard lock(mutex_);
+        retired.insert(retired.end(), orphans_.begin(), orphans_.end());
+        orphans_.clear();
+    }
+
+    uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+    auto safe_begin = std::partition(retired.begin(), retired.end(), [epoch](const Retired& item) {
+        return item.epoch + 2 > epoch;
+    });
+
+    // Destroying an object may retire more blocks, which land in the emptied thread list
+    for (auto it = safe_begin; it != retired.end(); ++it) {
+        Free(it->block);
+    }
+    retired.erase(safe_begin, retired.end());
+
+    std::vector<Retired>& rest = Local().retired;
+    rest.insert(rest.end(), retired.begin(), retired.end());
+}
+
+inline EpochDomain::ThreadState::~ThreadState() {
+    EpochDomain& domain = Global();
+    record->state.store(0, std::memory_order_release);
+    nesting = 0;
+    online = false;
+
+    domain.TryAdvance();
+    domain.Collect();
+    {
+        std::lock_guard lock(domain.mutex_);
+        domain.orphans_.insert(domain.orphans_.end(), retired.begin(), retired.end());
+    }
+    record->in_use.store(false, std::memory_order_release);
+}
+
+inline EpochDomain::~EpochDomain() {
+    for (const Retired& item : orphans_) {
+        Free(item.block);
+    }
+    for (EpochRecord* record = head_.load(std::memory_order_relaxed); record;) {
+        delete std::exchange(record, record->next);
+    }
+}
+
+// Atomic pointers count as usual; a strong release that drops the count to zero retires the
+// block to `EpochDomain::Global()`. Not convertible to the other policies and not usable with
+// `EnableSharedFromThis`.
+struct EpochPolicy : AtomicPolicy {
+    using BlockBase = EpochBlockBase;
+};
+
+// Reads of the calling thread are protected until the guard is destroyed
+class EpochGuard {
+public:
+    EpochGuard() {
+        EpochDomain::Global().Enter();
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+    ~EpochGuard() {
+        EpochDomain::Global().Exit();
+    }
+};
+
+// A `SharedPtr` published for epoch-protected readers. It owns one strong reference of the
+// stored block. Stored pointers must point to the object of their control block, not to an
+// alias of it
+template <typename T>
+class EpochSharedPtr {
+public:
+    using Ptr = SharedPtr<T, EpochPolicy>;
+
+    EpochSharedPtr() = default;
+
+    EpochSharedPtr(Ptr value) : block_(Release(std::move(value))) {
+    }
+
+    EpochSharedPtr(const EpochSharedPtr&) = delete;
+    EpochSharedPtr& operator=(const EpochSharedPtr&) = delete;
+
+    ~EpochSharedPtr() {
+        Adopt(block_.load(std::memory_order_relaxed));
+    }
+
+    // Valid until the calling thread leaves its `EpochGuard` or declares a quiescent point
+    T* Get() const {
+        assert(EpochDomain::Global().IsReading() && "EpochSharedPtr read outside of a guard");
+        EpochBlockBase* block = block_.load(std::memory_order_seq_cst);
+        return block ? static_cast<T*>(block->GetRawPtr()) : nullptr;
+    }
+
+    // Counted copy of the stored pointer, usable outside of a guard
+    Ptr Load() const {
+        EpochGuard guard;
+        while (true) {
+            EpochBlockBase* block = block_.load(std::memory_order_seq_cst);
+            if (!block) {
+                return Ptr();
+            }
+            // Fails only if the block was swapped out after the load
+            if (block->TryIncStrongRef()) {
+                return Ptr::Adopt(block, static_cast<T*>(block->GetRawPtr()));
+            }
+        }
+    }
+
+    void Store(Ptr desired) {
+        Exchange(std::move(desired));
+    }
+
+    Ptr Exchange(Ptr desired) {
+        return Adopt(block_.exchange(Release(std::move(desired)), std::memory_order_seq_cst));
+    }
+
+private:
+    std::atomic<EpochBlockBase*> block_ = nullptr;
+
+    static EpochBlockBase* Release(Ptr value) {
+        EpochBlockBase* block = value.control_block_;
+        assert((!block || static_cast<const void*>(value.ptr_) == block->GetRawPtr()) &&
+               "EpochSharedPtr does not store aliased pointers");
+        value.control_block_ = nullptr;
+        value.ptr_ = nullptr;
+        return block;
+    }
+
+    static Ptr Adopt(EpochBlockBase* block) {
+        if (!block) {
+            return Ptr();
+        }
+        return Ptr::Adopt(block, static_cast<T*>(block->GetRawPtr()));
+    }
+};
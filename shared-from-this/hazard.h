@@ -0,0 +1,311 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Hazard pointers (Michael, "Hazard Pointers: Safe Memory Reclamation for Lock-Free Objects",
+// IEEE TPDS 2004).
+//
+// A reader publishes the control block it is about to use in a hazard record and then checks
+// that the block is still stored in the `HazardSharedPtr` it was read from. While the record
+// points to the block, the object is neither destroyed nor freed, so the reader never touches
+// `ref_cnt`. When the last strong reference of a `HazardPolicy` block is dropped, the
+// block is retired to the calling thread's list instead of being destroyed. Once the list
+// reaches the scan threshold, every retired block that no record points to is destroyed.
+
+struct HazardBlockBase;
+
+struct HazardRecord {
+    std::atomic<const void*> ptr = nullptr;
+    std::atomic<bool> active = false;
+    HazardRecord* next = nullptr;
+};
+
+class HazardDomain {
+public:
+    static constexpr size_t kDefaultScanThreshold = 64;
+
+    static HazardDomain& Global() {
+        static HazardDomain domain;
+        return domain;
+    }
+
+    HazardDomain() = default;
+
+    HazardDomain(const HazardDomain&) = delete;
+    HazardDomain& operator=(const HazardDomain&) = delete;
+
+    // No reader is left at this point
+    ~HazardDomain();
+
+    // Records are reused but never freed while the domain is alive
+    HazardRecord* AcquireRecord() {
+        for (HazardRecord* record = head_.load(std::memory_order_acquire); record;
+             record = record->next) {
+            if (!record->active.load(std::memory_order_relaxed) &&
+                !record->active.exchange(true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+
+        auto record = new HazardRecord;
+        record->active.store(true, std::memory_order_relaxed);
+        record->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+        record_count_.fetch_add(1, std::memory_order_relaxed);
+        return record;
+    }
+
+    void ReleaseRecord(HazardRecord* record) {
+        record->ptr.store(nullptr, std::memory_order_release);
+        record->active.store(false, std::memory_order_release);
+    }
+
+    void Retire(HazardBlockBase* block) {
+        std::vector<HazardBlockBase*>& retired = Retired().blocks;
+        retired.push_back(block);
+        if (retired.size() >= ScanThreshold()) {
+            Scan();
+        }
+    }
+
+    // Destroys the unprotected blocks retired by the calling thread and by exited threads
+    void Reclaim() {
+        Scan();
+    }
+
+    // A scan costs O(records + retired), so it runs once at least this many blocks are
+    // retired, and never before twice the number of records
+    void SetScanThreshold(size_t threshold) {
+        scan_threshold_.store(threshold, std::memory_order_relaxed);
+    }
+
+    size_t ScanThreshold() const {
+        return std::max(scan_threshold_.load(std::memory_order_relaxed),
+                        2 * record_count_.load(std::memory_order_relaxed));
+    }
+
+private:
+    // Blocks left over at thread exit are handed to the domain
+    struct RetiredList {
+        std::vector<HazardBlockBase*> blocks;
+
+        ~RetiredList();
+    };
+
+    static RetiredList& Retired() {
+        static thread_local RetiredList list;
+        return list;
+    }
+
+    static void Free(HazardBlockBase* block);
+
+    // Returns the number of freed blocks
+    size_t Scan();
+
+    std::atomic<HazardRecord*> head_ = nullptr;
+    std::atomic<size_t> record_count_ = 0;
+    std::atomic<size_t> scan_threshold_ = kDefaultScanThreshold;
+
+    std::mutex mutex_;
+    std::vector<HazardBlockBase*> orphans_;
+};
+
+struct HazardBlockBase : ControlBlockBase {
+    // The last release retires the block, so the caller never destroys it
+    template <typename Policy>
+    size_t DecStrongRef(size_t count = 1) {
+        size_t result = ControlBlockBase::DecStrongRef<Policy>(count);
+        if (result == 0) {
+            HazardDomain::Global().Retire(this);
+            return 1;
+        }
+        return result;
+    }
+};
+
+inline void HazardDomain::Free(HazardBlockBase* block) {
+    block->ReleaseObject();
+}
+
+inline size_t HazardDomain::Scan() {
+    std::vector<HazardBlockBase*> blocks;
+    blocks.swap(Retired().blocks);
+    {
+        std::lock_guard lock(mutex_);
+        blocks.insert(blocks.end(), orphans_.begin(), orphans_.end());
+        orphans_.clear();
+    }
+
+    // Pairs with the `seq_cst` store in `HazardPointer`: a reader that has not yet
+    // published its record sees the block removed from the source and retries
+    std::vector<const void*> hazards;
+    for (HazardRecord* record = head_.load(std::memory_order_acquire); record;
+         record = record->next) {
+        if (const void* ptr = record->ptr.load(std::memory_order_seq_cst)) {
+            hazards.push_back(ptr);
+        }
+    }
+    std::sort(hazards.begin(), hazards.end());
+
+    auto protected_end = std::partition(blocks.begin(), blocks.end(), [&](HazardBlockBase* block) {
+        return std::binary_search(hazards.begin(), hazards.end(),
+                                  static_cast<const void*>(block));
+    });
+    size_t freed = blocks.end() - protected_end;
+
+    // Destroying an object may retire more blocks, which land in the emptied thread list
+    for (auto it = protected_end; it != blocks.end(); ++it) {
+        Free(*it);
+    }
+    blocks.erase(protected_end, blocks.end());
+
+    std::vector<HazardBlockBase*>& retired = Retired().blocks;
+    retired.insert(retired.end(), blocks.begin(), blocks.end());
+    return freed;
+}
+
+inline HazardDomain::RetiredList::~RetiredList() {
+    HazardDomain& domain = Global();
+    while (!blocks.empty() && domain.Scan() > 0) {
+    }
+    std::lock_guard lock(domain.mutex_);
+    domain.orphans_.insert(domain.orphans_.end(), blocks.begin(), blocks.end());
+}
+
+inline HazardDomain::~HazardDomain() {
+    for (HazardBlockBase* block : orphans_) {
+        Free(block);
+    }
+    for (HazardRecord* record = head_.load(std::memory_order_relaxed); record;) {
+        delete std::exchange(record, record->next);
+    }
+}
+
+// Atomic pointers count as usual; a strong release that drops the count to zero retires the
+// block to `HazardDomain::Global()`. Not convertible to the other policies and not usable with
+// `EnableSharedFromThis`.
+struct HazardPolicy : AtomicPolicy {
+    using BlockBase = HazardBlockBase;
+};
+
+// A `SharedPtr` published for hazard-protected readers. It owns one strong reference of the
+// stored block. Stored pointers must point to the object of their control block, not to an
+// alias of it
+template <typename T>
+class HazardSharedPtr {
+    friend class HazardPointer;
+
+public:
+    using Ptr = SharedPtr<T, HazardPolicy>;
+
+    HazardSharedPtr() = default;
+
+    HazardSharedPtr(Ptr value) : block_(Release(std::move(value))) {
+    }
+
+    HazardSharedPtr(const HazardSharedPtr&) = delete;
+    HazardSharedPtr& operator=(const HazardSharedPtr&) = delete;
+
+    ~HazardSharedPtr() {
+        Adopt(block_.load(std::memory_order_relaxed));
+    }
+
+    // Counted copy of the stored pointer, see `HazardPointer` for reading without one
+    Ptr Load() const;
+
+    void Store(Ptr desired) {
+        Exchange(std::move(desired));
+    }
+
+    Ptr Exchange(Ptr desired) {
+        return Adopt(block_.exchange(Release(std::move(desired)), std::memory_order_seq_cst));
+    }
+
+private:
+    std::atomic<HazardBlockBase*> block_ = nullptr;
+
+    static HazardBlockBase* Release(Ptr value) {
+        HazardBlockBase* block = value.control_block_;
+        assert((!block || static_cast<const void*>(value.ptr_) == block->GetRawPtr()) &&
+               "HazardSharedPtr does not store aliased pointers");
+        value.control_block_ = nullptr;
+        value.ptr_ = nullptr;
+        return block;
+    }
+
+    static Ptr Adopt(HazardBlockBase* block) {
+        if (!block) {
+            return Ptr();
+        }
+        return Ptr::Adopt(block, static_cast<T*>(block->GetRawPtr()));
+    }
+};
+
+// Protects one object at a time. The pointer returned by `Protect` stays valid until the next
+// `Protect`, `Reset` or the destructor, even if the source is changed and every `SharedPtr` to
+// the object is released meanwhile.
+class HazardPointer {
+public:
+    HazardPointer() : record_(HazardDomain::Global().AcquireRecord()) {
+    }
+
+    HazardPointer(const HazardPointer&) = delete;
+    HazardPointer& operator=(const HazardPointer&) = delete;
+
+    ~HazardPointer() {
+        HazardDomain::Global().ReleaseRecord(record_);
+    }
+
+    template <typename T>
+    T* Protect(const HazardSharedPtr<T>& source) {
+        HazardBlockBase* block = ProtectBlock(source.block_);
+        return block ? static_cast<T*>(block->GetRawPtr()) : nullptr;
+    }
+
+    void Reset() {
+        record_->ptr.store(nullptr, std::memory_order_release);
+    }
+
+private:
+    template <typename T>
+    friend class HazardSharedPtr;
+
+    HazardRecord* record_;
+
+    HazardBlockBase* ProtectBlock(const std::atomic<HazardBlockBase*>& source) {
+        HazardBlockBase* block = source.load(std::memory_order_relaxed);
+        while (true) {
+            record_->ptr.store(block, std::memory_order_seq_cst);
+            HazardBlockBase* current = source.load(std::memory_order_seq_cst);
+            if (current == block) {
+                return block;
+            }
+            block = current;
+        }
+    }
+};
+
+template <typename T>
+typename HazardSharedPtr<T>::Ptr HazardSharedPtr<T>::Load() const {
+    HazardPointer hazard;
+    while (true) {
+        HazardBlockBase* block = hazard.ProtectBlock(block_);
+        if (!block) {
+            return Ptr();
+        }
+        // Fails only if the block was swapped out after it was protected
+        if (block->TryIncStrongRef()) {
+            return Ptr::Adopt(block, static_cast<T*>(block->GetRawPtr()));
+        }
+    }
+}
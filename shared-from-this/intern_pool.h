@@ -0,0 +1,134 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+// Flyweights: equal values share one immutable object. The pool keeps only `WeakPtr`s, so a
+// value is destroyed with its last `SharedPtr` and its entry is erased later, by a lookup that
+// finds it expired or by the sweep that every insert does on a few buckets of its shard.
+//
+// Values are spread over `kShardCount` shards by hash, each with its own mutex, so threads
+// contend only when their values land in the same shard. A hit takes the shard lock and one
+// atomic increment and does not allocate.
+//
+// `Hash` and `Eq` may also accept other key types, e.g. `std::string_view` for strings, so that
+// a hit does not need a `T` at all. A `T` is built from the key on a miss
+template <typename T, typename Hash = std::hash<T>, typename Eq = std::equal_to<T>>
+class InternPool;
+
+// Keys other than `T` need transparent `Hash` and `Eq`, as in the heterogeneous lookup of the
+// standard containers. The defaults would silently build a `T` from the key on every hit
+template <typename Key, typename T, typename Hash, typename Eq>
+concept InternKey =
+    std::is_constructible_v<T, Key&&> &&
+    (std::is_same_v<std::remove_cvref_t<Key>, T> ||
+     (requires { typename Hash::is_transparent; } && requires { typename Eq::is_transparent; }));
+
+template <typename T, typename Hash, typename Eq>
+class InternPool {
+public:
+    static constexpr size_t kShardCount = 64;
+    // Buckets of the shard swept per insert, see `WeakKeyedMap`
+    static constexpr size_t kSweepPerInsert = 2;
+
+    explicit InternPool(const Hash& hash = Hash(), const Eq& eq = Eq()) : hash_(hash), eq_(eq) {
+    }
+
+    InternPool(const InternPool&) = delete;
+    InternPool& operator=(const InternPool&) = delete;
+
+    // The shared object equal to `key`, created with `MakeShared` if there is none
+    template <typename Key>
+        requires InternKey<Key, T, Hash, Eq>
+    SharedPtr<const T> Intern(Key&& key) {
+        size_t hash = hash_(std::as_const(key));
+        Shard& shard = shards_[hash % kShardCount];
+        std::lock_guard lock(shard.mutex);
+
+        auto [first, last] = shard.entries.equal_range(hash);
+        while (first != last) {
+            if (SharedPtr<const T> value = first->second.Lock()) {
+                if (eq_(*value, std::as_const(key))) {
+                    return value;
+                }
+                ++first;
+            } else {
+                first = shard.entries.erase(first);
+            }
+        }
+
+        Sweep(&shard, kSweepPerInsert);
+        SharedPtr<const T> value = MakeShared<T>(std::forward<Key>(key));
+        shard.entries.emplace(hash, value);
+        return value;
+    }
+
+    // Erases the entries of every destroyed value. Returns the number of entries erased
+    size_t SweepAll() {
+        size_t erased = 0;
+        for (Shard& shard : shards_) {
+            std::lock_guard lock(shard.mutex);
+            erased += Sweep(&shard, shard.entries.bucket_count());
+        }
+        return erased;
+    }
+
+    // Includes entries of destroyed values that have not been erased yet
+    size_t Size() const {
+        size_t size = 0;
+        for (const Shard& shard : shards_) {
+            std::lock_guard lock(shard.mutex);
+            size += shard.entries.size();
+        }
+        return size;
+    }
+
+private:
+    // Entries are keyed by the hash, since the value may be gone
+    struct IdentityHash {
+        size_t operator()(size_t hash) const {
+            return hash;
+        }
+    };
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::unordered_multimap<size_t, WeakPtr<const T>, IdentityHash> entries;
+        // The next bucket to sweep
+        size_t cursor = 0;
+    };
+
+    [[no_unique_address]] Hash hash_;
+    [[no_unique_address]] Eq eq_;
+    Shard shards_[kShardCount];
+
+    static size_t Sweep(Shard* shard, size_t buckets) {
+        auto& entries = shard->entries;
+        size_t erased = 0;
+        for (size_t i = 0; i < buckets && !entries.empty(); ++i) {
+            size_t bucket = shard->cursor++ % entries.bucket_count();
+            for (auto local = entries.begin(bucket); local != entries.end(bucket);) {
+                if (local->second.Expired()) {
+                    // Local iterators cannot be erased, so find the entry by owner
+                    auto it = entries.find(local->first);
+                    while (!it->second.OwnerEqual(local->second)) {
+                        ++it;
+                    }
+                    ++local;
+                    entries.erase(it);
+                    ++erased;
+                } else {
+                    ++local;
+                }
+            }
+        }
+        return erased;
+    }
+};
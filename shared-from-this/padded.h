@@ -0,0 +1,30 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <cstddef>
+
+// Cache-line isolated control blocks for a few hot objects. A `PaddedPolicy` block starts on a
+// cache line of its own and the object starts on the next one, so updates of the counters never
+// invalidate a line that holds the object or another block. Blocks of neighboring objects stop
+// slowing each other down when different cores copy them, and readers of the object stop
+// slowing down copies of its pointers.
+//
+// Every block takes at least two cache lines instead of a few words and is never taken from a
+// `BlockPool`. Counters of one block bumped from many cores still share their line, see
+// bench/contention.cpp. Not convertible to the other policies and not usable with
+// `EnableSharedFromThis`.
+
+inline constexpr size_t kCacheLineSize = 64;
+
+struct alignas(kCacheLineSize) PaddedBlockBase : ControlBlockBase {
+    // Alignment alone would leave tail padding, which the members of a derived block may reuse
+    char padding[kCacheLineSize - sizeof(ControlBlockBase)];
+};
+
+static_assert(sizeof(PaddedBlockBase) == kCacheLineSize);
+
+struct PaddedPolicy : AtomicPolicy {
+    using BlockBase = PaddedBlockBase;
+};
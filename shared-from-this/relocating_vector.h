@@ -0,0 +1,229 @@
+#pragma once
+
+#include "relocation.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+
+// A subset of `std::vector`. Growth, `Insert` and `Erase` move trivially relocatable elements,
+// e.g. `SharedPtr`s, with `memcpy`/`memmove` instead of one move and one destructor call each.
+// Other element types must be nothrow movable
+template <typename T>
+class RelocatingVector {
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    RelocatingVector() = default;
+
+    // Built aside, so that a throwing copy frees what was copied so far
+    RelocatingVector(const RelocatingVector& other) {
+        RelocatingVector copy;
+        copy.Reserve(other.size_);
+        for (const T& value : other) {
+            copy.PushBack(value);
+        }
+        Swap(copy);
+    }
+
+    RelocatingVector(RelocatingVector&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)),
+          size_(std::exchange(other.size_, 0)),
+          capacity_(std::exchange(other.capacity_, 0)) {
+    }
+
+    RelocatingVector& operator=(RelocatingVector other) noexcept {
+        Swap(other);
+        return *this;
+    }
+
+    ~RelocatingVector() {
+        Clear();
+        Deallocate(data_, capacity_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reserve(size_t capacity) {
+        if (capacity > capacity_) {
+            T* data = Allocate(capacity);
+            Relocate(data_, size_, data);
+            Deallocate(data_, capacity_);
+            data_ = data;
+            capacity_ = capacity;
+        }
+    }
+
+    void PushBack(const T& value) {
+        EmplaceBack(value);
+    }
+
+    void PushBack(T&& value) {
+        EmplaceBack(std::move(value));
+    }
+
+    template <typename... Args>
+    T& EmplaceBack(Args&&... args) {
+        return *Emplace(end(), std::forward<Args>(args)...);
+    }
+
+    void PopBack() {
+        assert(size_ > 0);
+        data_[--size_].~T();
+    }
+
+    iterator Insert(const_iterator pos, const T& value) {
+        return Emplace(pos, value);
+    }
+
+    iterator Insert(const_iterator pos, T&& value) {
+        return Emplace(pos, std::move(value));
+    }
+
+    // `args` may refer to an element of the vector
+    template <typename... Args>
+    iterator Emplace(const_iterator pos, Args&&... args) {
+        size_t index = pos - data_;
+        assert(index <= size_);
+        if (size_ == capacity_) {
+            size_t capacity = std::max<size_t>(2 * capacity_, 1);
+            T* data = Allocate(capacity);
+            try {
+                ::new (static_cast<void*>(data + index)) T(std::forward<Args>(args)...);
+            } catch (...) {
+                Deallocate(data, capacity);
+                throw;
+            }
+            Relocate(data_, index, data);
+            Relocate(data_ + index, size_ - index, data + index + 1);
+            Deallocate(data_, capacity_);
+            data_ = data;
+            capacity_ = capacity;
+        } else if (index == size_) {
+            ::new (static_cast<void*>(data_ + index)) T(std::forward<Args>(args)...);
+        } else if constexpr (kIsTriviallyRelocatable<T>) {
+            // Built aside first, so that a throwing constructor leaves the vector as it was
+            alignas(T) unsigned char value[sizeof(T)];
+            ::new (static_cast<void*>(value)) T(std::forward<Args>(args)...);
+            Relocate(data_ + index, size_ - index, data_ + index + 1);
+            std::memcpy(static_cast<void*>(data_ + index), value, sizeof(T));
+        } else {
+            T value(std::forward<Args>(args)...);
+            ::new (static_cast<void*>(data_ + size_)) T(std::move(data_[size_ - 1]));
+            std::move_backward(data_ + index, data_ + size_ - 1, data_ + size_);
+            data_[index] = std::move(value);
+        }
+        ++size_;
+        return data_ + index;
+    }
+
+    iterator Erase(const_iterator pos) {
+        return Erase(pos, pos + 1);
+    }
+
+    iterator Erase(const_iterator first, const_iterator last) {
+        size_t index = first - data_;
+        size_t count = last - first;
+        assert(index + count <= size_);
+        if constexpr (kIsTriviallyRelocatable<T>) {
+            Destroy(data_ + index, count);
+            Relocate(data_ + index + count, size_ - index - count, data_ + index);
+        } else {
+            std::move(data_ + index + count, data_ + size_, data_ + index);
+            Destroy(data_ + size_ - count, count);
+        }
+        size_ -= count;
+        return data_ + index;
+    }
+
+    void Clear() {
+        Destroy(data_, size_);
+        size_ = 0;
+    }
+
+    void Swap(RelocatingVector& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(capacity_, other.capacity_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T& operator[](size_t index) {
+        return data_[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    T* Data() {
+        return data_;
+    }
+
+    const T* Data() const {
+        return data_;
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    iterator begin() {
+        return data_;
+    }
+
+    iterator end() {
+        return data_ + size_;
+    }
+
+    const_iterator begin() const {
+        return data_;
+    }
+
+    const_iterator end() const {
+        return data_ + size_;
+    }
+
+private:
+    T* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+
+    static T* Allocate(size_t capacity) {
+        return std::allocator<T>().allocate(capacity);
+    }
+
+    static void Deallocate(T* data, size_t capacity) {
+        if (data) {
+            std::allocator<T>().deallocate(data, capacity);
+        }
+    }
+
+    static void Destroy(T* first, size_t count) {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (size_t i = 0; i < count; ++i) {
+                first[i].~T();
+            }
+        }
+    }
+};
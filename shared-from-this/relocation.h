@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Whether an object of type `T` can be moved to another address with `memcpy`, the old copy
+// being forgotten without its destructor. True for trivially copyable types; specialize for
+// types that do not point into themselves, as the pointers of this library do
+template <typename T>
+struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {};
+
+template <typename T>
+inline constexpr bool kIsTriviallyRelocatable = IsTriviallyRelocatable<T>::value;
+
+// Moves `count` objects from `from` to the raw memory at `to`, leaving `from` raw. The ranges
+// may overlap only for trivially relocatable types
+template <typename T>
+void Relocate(T* from, size_t count, T* to) {
+    if constexpr (kIsTriviallyRelocatable<T>) {
+        if (count > 0) {
+            std::memmove(static_cast<void*>(to), static_cast<const void*>(from),
+                         count * sizeof(T));
+        }
+    } else {
+        static_assert(std::is_nothrow_move_constructible_v<T>,
+                      "Relocate needs T to be trivially relocatable or nothrow movable");
+        for (size_t i = 0; i < count; ++i) {
+            ::new (static_cast<void*>(to + i)) T(std::move(from[i]));
+            from[i].~T();
+        }
+    }
+}
@@ -1,110 +1,689 @@
 #pragma once
 
 #include "sw_fwd.h"  // Forward declaration
+#include "block_pool.h"
+#include "relocation.h"
 
+#include <unique/compressed_pair.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+struct ControlBlockBase;
+
+// Both counters of a block share one word, see `ControlBlockBase`. `delta` is already shifted
+// to the counter being updated, and `mask` selects it
+
+// Pointers may be copied and destroyed on any thread
+struct AtomicPolicy {
+    using BlockBase = ControlBlockBase;
+
+    static uint64_t Increment(std::atomic<uint64_t>& counter, uint64_t delta) {
+        return counter.fetch_add(delta, std::memory_order_relaxed) + delta;
+    }
+
+    static uint64_t Decrement(std::atomic<uint64_t>& counter, uint64_t delta, uint64_t mask) {
+        uint64_t result = counter.fetch_sub(delta, std::memory_order_release) - delta;
+        if ((result & mask) == 0) {
+            // Synchronize with all previous releases before the object is destroyed
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return result;
+    }
+
+    // Returns the new word, or 0 if the counter was zero
+    static uint64_t IncrementIfNonZero(std::atomic<uint64_t>& counter, uint64_t delta,
+                                       uint64_t mask) {
+        uint64_t current = counter.load(std::memory_order_relaxed);
+        do {
+            if ((current & mask) == 0) {
+                return 0;
+            }
+        } while (!counter.compare_exchange_weak(current, current + delta,
+                                                std::memory_order_acquire,
+                                                std::memory_order_relaxed));
+        return current + delta;
+    }
+
+    static void CheckThread(std::thread::id) {
+    }
+};
+
+// Pointers never leave the thread that created the block: counters are updated with plain
+// loads and stores, without a locked instruction
+struct SingleThreadedPolicy {
+    using BlockBase = ControlBlockBase;
+
+    static uint64_t Increment(std::atomic<uint64_t>& counter, uint64_t delta) {
+        uint64_t result = counter.load(std::memory_order_relaxed) + delta;
+        counter.store(result, std::memory_order_relaxed);
+        return result;
+    }
+
+    static uint64_t Decrement(std::atomic<uint64_t>& counter, uint64_t delta, uint64_t) {
+        uint64_t result = counter.load(std::memory_order_relaxed) - delta;
+        counter.store(result, std::memory_order_relaxed);
+        return result;
+    }
+
+    static uint64_t IncrementIfNonZero(std::atomic<uint64_t>& counter, uint64_t delta,
+                                       uint64_t mask) {
+        uint64_t current = counter.load(std::memory_order_relaxed);
+        if ((current & mask) == 0) {
+            return 0;
+        }
+        counter.store(current + delta, std::memory_order_relaxed);
+        return current + delta;
+    }
+
+    static void CheckThread([[maybe_unused]] std::thread::id owner) {
+        assert(owner == std::this_thread::get_id() &&
+               "SingleThreadedPolicy pointer used outside of its owner thread");
+    }
+};
+
+// Operations that depend on the type of the block, see `ControlBlockBase::manager`
+enum class BlockOp {
+    kGetRawPtr,
+    kDestroy,
+    kDelete,
+    kDestroyAndDelete,
+};
+
+// All `SharedPtr`-s of a block share one extra weak reference, which is dropped right after
+// `Destroy()`. That way only the owner of the last weak reference deletes the block.
+//
+// Instead of virtual functions every block type sets `manager` to its own static function. No
+// vtable or type info is emitted per `T`, and a last release with no `WeakPtr` left takes a
+// single indirect call.
+//
+// The strong count takes the low half of `ref_cnt` and the weak count the high half, so the
+// whole header is two words. The object is destroyed exactly when the strong count drops to
+// zero, so there is no separate flag for it.
 struct ControlBlockBase {
-    size_t strong_ref_cnt = 0;
-    size_t weak_ref_cnt = 0;
-    bool is_destroyed = false;
+    using Manager = void* (*)(ControlBlockBase*, BlockOp);
 
-    size_t IncStrongRef() {
-        return ++strong_ref_cnt;
+    static constexpr int kWeakShift = 32;
+    static constexpr uint64_t kOneStrong = 1;
+    static constexpr uint64_t kOneWeak = uint64_t{1} << kWeakShift;
+    static constexpr uint64_t kStrongMask = kOneWeak - 1;
+    static constexpr uint64_t kWeakMask = ~kStrongMask;
+    // Reported long before a carry could reach the other half
+    static constexpr size_t kMaxCount = size_t{1} << 31;
+
+    Manager manager = nullptr;
+    std::atomic<uint64_t> ref_cnt = kOneWeak;
+#ifndef NDEBUG
+    std::thread::id owner_thread = std::this_thread::get_id();
+#endif
+
+    template <typename Policy = AtomicPolicy>
+    size_t IncStrongRef(size_t count = 1) {
+        CheckThread<Policy>();
+        return CheckCount(Strong(Policy::Increment(ref_cnt, count * kOneStrong)));
+    }
+
+    template <typename Policy = AtomicPolicy>
+    size_t DecStrongRef(size_t count = 1) {
+        CheckThread<Policy>();
+        return Strong(Policy::Decrement(ref_cnt, count * kOneStrong, kStrongMask));
     }
 
-    size_t DecStrongRef() {
-        return --strong_ref_cnt;
+    // Never revives an object whose strong count has already dropped to zero
+    template <typename Policy = AtomicPolicy>
+    bool TryIncStrongRef() {
+        CheckThread<Policy>();
+        uint64_t word = Policy::IncrementIfNonZero(ref_cnt, kOneStrong, kStrongMask);
+        return word && CheckCount(Strong(word));
     }
 
     size_t GetStrongCounter() const {
-        return strong_ref_cnt;
+        return Strong(ref_cnt.load(std::memory_order_relaxed));
     }
 
-    size_t IncWeakRef() {
-        return ++weak_ref_cnt;
+    template <typename Policy = AtomicPolicy>
+    size_t IncWeakRef(size_t count = 1) {
+        CheckThread<Policy>();
+        return CheckCount(Weak(Policy::Increment(ref_cnt, count * kOneWeak)));
     }
 
-    size_t DecWeakRef() {
-        return --weak_ref_cnt;
+    template <typename Policy = AtomicPolicy>
+    size_t DecWeakRef(size_t count = 1) {
+        CheckThread<Policy>();
+        return Weak(Policy::Decrement(ref_cnt, count * kOneWeak, kWeakMask));
     }
 
     size_t GetWeakCounter() const {
-        return weak_ref_cnt;
+        return Weak(ref_cnt.load(std::memory_order_relaxed));
+    }
+
+    // Called once the strong count has dropped to zero: destroys the object and drops the weak
+    // reference of the strong owners
+    template <typename Policy = AtomicPolicy>
+    void ReleaseObject() {
+        // With no `WeakPtr` left nobody can take a weak reference anymore
+        if (Weak(ref_cnt.load(std::memory_order_acquire)) == 1) {
+            manager(this, BlockOp::kDestroyAndDelete);
+            return;
+        }
+        Destroy();
+        if (DecWeakRef<Policy>() == 0) {
+            Delete();
+        }
+    }
+
+    template <typename Policy>
+    void CheckThread() const {
+#ifndef NDEBUG
+        Policy::CheckThread(owner_thread);
+#endif
+    }
+
+    // Called when a pointer of a different policy is explicitly converted to `Policy`
+    template <typename Policy>
+    void AdoptThread() {
+#ifndef NDEBUG
+        if constexpr (std::is_same_v<Policy, SingleThreadedPolicy>) {
+            owner_thread = std::this_thread::get_id();
+        }
+#endif
+    }
+
+    void* GetRawPtr() {
+        return manager(this, BlockOp::kGetRawPtr);
     }
 
-    size_t GetAllCounter() const {
-        return strong_ref_cnt + weak_ref_cnt;
+    void Destroy() {
+        manager(this, BlockOp::kDestroy);
     }
 
-    bool IsDestroyed() const {
-        return is_destroyed;
+    void Delete() {
+        manager(this, BlockOp::kDelete);
     }
 
-    bool CanDeleteControlBlock() const {
-        return GetAllCounter() == 0;
+    static size_t Strong(uint64_t word) {
+        return word & kStrongMask;
     }
 
-    virtual void* GetRawPtr() = 0;
+    static size_t Weak(uint64_t word) {
+        return word >> kWeakShift;
+    }
 
-    virtual ~ControlBlockBase() = default;
-    virtual void Destroy() = 0;
+    // Like `std::terminate`, there is no way to go on with a corrupted count
+    static size_t CheckCount(size_t count) {
+        if (count >= kMaxCount) [[unlikely]] {
+            std::cerr << "SharedPtr reference count overflow" << std::endl;
+            std::abort();
+        }
+        return count;
+    }
 };
 
-template <typename T>
-struct DefaultBlock : ControlBlockBase {
-    T* deletem_ptr;
+// Blocks come from `BlockPool` unless `SHARED_NO_BLOCK_POOL` is defined. `T` is an array type
+// for pointers from `new[]`
+template <typename T, typename Base = ControlBlockBase>
+struct DefaultBlock : Base {
+    std::remove_extent_t<T>* deletem_ptr;
 
-    DefaultBlock(T* ptr) : deletem_ptr(ptr) {
+    DefaultBlock(std::remove_extent_t<T>* ptr) : deletem_ptr(ptr) {
+        this->manager = &Manage;
     }
 
-    void Destroy() override {
-        if (!is_destroyed) {
-            strong_ref_cnt = 0;
-            is_destroyed = true;
+#ifndef SHARED_NO_BLOCK_POOL
+    static void* operator new([[maybe_unused]] size_t size) {
+        assert(size == sizeof(DefaultBlock));
+        return BlockPool<sizeof(DefaultBlock)>::Allocate();
+    }
 
-            if (deletem_ptr) {
-                delete deletem_ptr;
-            }
+    static void operator delete(void* ptr) {
+        BlockPool<sizeof(DefaultBlock)>::Deallocate(ptr);
+    }
+
+    // Over-aligned blocks, e.g. of `PaddedPolicy`, bypass the pool
+    static void* operator new(size_t size, std::align_val_t align) {
+        return ::operator new(size, align);
+    }
+
+    static void operator delete(void* ptr, std::align_val_t align) {
+        ::operator delete(ptr, align);
+    }
+#endif
+
+    static void* Manage(ControlBlockBase* base, BlockOp op) {
+        auto block = static_cast<DefaultBlock*>(base);
+        switch (op) {
+            case BlockOp::kGetRawPtr:
+                return block->deletem_ptr;
+            case BlockOp::kDestroy:
+                block->DeleteObject();
+                break;
+            case BlockOp::kDelete:
+                delete block;
+                break;
+            case BlockOp::kDestroyAndDelete:
+                block->DeleteObject();
+                delete block;
+                break;
         }
+        return nullptr;
     }
 
-    void* GetRawPtr() override {
-        return deletem_ptr;
+    void DeleteObject() {
+        if constexpr (std::is_array_v<T>) {
+            delete[] deletem_ptr;
+        } else {
+            delete deletem_ptr;
+        }
     }
 };
 
+// Specialize as `std::true_type` to take `MakeShared<T>` blocks from a `BlockPool` shared by
+// every pooled type of the same size class. Meant for a few hot types, see `ReserveShared`
 template <typename T>
-struct InlineBlock : ControlBlockBase {
+struct PooledBlocks : std::false_type {};
+
+#ifndef SHARED_EARLY_RELEASE_BYTES
+#define SHARED_EARLY_RELEASE_BYTES (256 * 1024)
+#endif
+
+// The storage of a `MakeShared<T>` object of `SHARED_EARLY_RELEASE_BYTES` or more is returned to
+// the OS with the last `SharedPtr`, while `WeakPtr`s still keep the block. Specialize to override
+// the threshold for a type
+template <typename T>
+struct EarlyRelease : std::bool_constant<sizeof(T) >= SHARED_EARLY_RELEASE_BYTES> {};
+
+// A `MakeShared<T[]>` array is measured as a whole, with its length known at run time only:
+// `EarlyRelease<T[]>` allows its release once it takes the threshold. Specialize it with
+// `std::false_type` to keep the arrays of `T`
+template <typename T>
+struct EarlyRelease<T[]> : std::true_type {};
+
+// Drops the whole pages inside [ptr, ptr + size) from memory: they stay mapped and read as zeros
+// when touched again. A no-op where `madvise` is not available
+inline void ReleasePages([[maybe_unused]] void* ptr, [[maybe_unused]] size_t size) {
+#ifdef __linux__
+    static const uintptr_t kPage = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(ptr) + kPage - 1) & ~(kPage - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + size) & ~(kPage - 1);
+    if (begin < end) {
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+    }
+#endif
+}
+
+// Selects default-initialization of the object, see `MakeSharedForOverwrite`
+struct ForOverwriteTag {};
+
+template <typename T, typename Base = ControlBlockBase>
+struct InlineBlock : Base {
     alignas(T) char storage[sizeof(T)];
 
     template <typename... Args>
     InlineBlock(Args&&... args) {
-        new (storage) T(std::forward<Args>(args)...);
+        ::new (storage) T(std::forward<Args>(args)...);
+        this->manager = &Manage;
+    }
+
+    InlineBlock(ForOverwriteTag) {
+        ::new (storage) T;
+        this->manager = &Manage;
+    }
+
+    // Pool slots are only aligned for `std::max_align_t`
+#ifdef SHARED_NO_BLOCK_POOL
+    static constexpr bool kPooled = false;
+#else
+    static constexpr bool kPooled = PooledBlocks<std::remove_cv_t<T>>::value &&
+                                    alignof(T) <= alignof(std::max_align_t) &&
+                                    alignof(Base) <= alignof(std::max_align_t);
+#endif
+    static void* operator new(size_t size) {
+        if constexpr (kPooled) {
+            static_assert(alignof(InlineBlock) <= alignof(std::max_align_t));
+            assert(size == sizeof(InlineBlock));
+            return SizeClassPool<InlineBlock>::Allocate();
+        } else {
+            return ::operator new(size);
+        }
+    }
+
+    // Taken by `new` for an over-aligned block, e.g. of an `alignas(64)` type, which the class
+    // `operator new` above would otherwise get with the default alignment only
+    static void* operator new(size_t size, std::align_val_t align) {
+        return ::operator new(size, align);
+    }
+
+    static void operator delete(void* ptr) {
+        if constexpr (kPooled) {
+            SizeClassPool<InlineBlock>::Deallocate(ptr);
+        } else {
+            ::operator delete(ptr);
+        }
+    }
+
+    static void operator delete(void* ptr, std::align_val_t align) {
+        ::operator delete(ptr, align);
+    }
+
+    static void* Manage(ControlBlockBase* base, BlockOp op) {
+        auto block = static_cast<InlineBlock*>(base);
+        switch (op) {
+            case BlockOp::kGetRawPtr:
+                return block->storage;
+            case BlockOp::kDestroy:
+                reinterpret_cast<T*>(block->storage)->~T();
+                if constexpr (EarlyRelease<std::remove_cv_t<T>>::value) {
+                    ReleasePages(block->storage, sizeof(T));
+                }
+                break;
+            case BlockOp::kDelete:
+                delete block;
+                break;
+            case BlockOp::kDestroyAndDelete:
+                reinterpret_cast<T*>(block->storage)->~T();
+                delete block;
+                break;
+        }
+        return nullptr;
+    }
+};
+// The control block, the element count and `count` elements of `T` in one allocation. Elements
+// are destroyed in reverse order, trivially destructible ones not at all
+template <typename T, typename Base = ControlBlockBase>
+struct ArrayBlock : Base {
+    size_t count;
+
+    // Default-initializes the elements if `kForOverwrite`, value-initializes them otherwise
+    template <bool kForOverwrite>
+    static ArrayBlock* Create(size_t count) {
+        if (count > (SIZE_MAX - Offset()) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        auto block = new (Allocate(Offset() + count * sizeof(T))) ArrayBlock(count);
+        Element* elements = block->Elements();
+        size_t constructed = 0;
+        try {
+            for (; constructed < count; ++constructed) {
+                if constexpr (kForOverwrite) {
+                    ::new (elements + constructed) Element;
+                } else {
+                    ::new (elements + constructed) Element();
+                }
+            }
+        } catch (...) {
+            block->DestroyElements(constructed);
+            block->Free();
+            throw;
+        }
+        return block;
+    }
+
+    static void* Manage(ControlBlockBase* base, BlockOp op) {
+        auto block = static_cast<ArrayBlock*>(base);
+        switch (op) {
+            case BlockOp::kGetRawPtr:
+                return block->Elements();
+            case BlockOp::kDestroy:
+                block->DestroyElements(block->count);
+                if (EarlyRelease<Element[]>::value &&
+                    block->count * sizeof(T) >= SHARED_EARLY_RELEASE_BYTES) {
+                    ReleasePages(block->Elements(), block->count * sizeof(T));
+                }
+                break;
+            case BlockOp::kDelete:
+                block->Free();
+                break;
+            case BlockOp::kDestroyAndDelete:
+                block->DestroyElements(block->count);
+                block->Free();
+                break;
+        }
+        return nullptr;
+    }
+
+private:
+    using Element = std::remove_cv_t<T>;
+
+    // Of the elements or of the block, e.g. with `PaddedPolicy`
+    static constexpr size_t kAlignment = std::max(alignof(T), alignof(Base));
+    static constexpr bool kOverAligned = kAlignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+    explicit ArrayBlock(size_t count) : count(count) {
+        this->manager = &Manage;
+    }
+
+    // Elements start at the first multiple of `alignof(T)` past the block
+    static constexpr size_t Offset() {
+        return (sizeof(ArrayBlock) + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+
+    static void* Allocate(size_t size) {
+        if constexpr (kOverAligned) {
+            return ::operator new(size, std::align_val_t(kAlignment));
+        } else {
+            return ::operator new(size);
+        }
+    }
+
+    Element* Elements() {
+        return reinterpret_cast<Element*>(reinterpret_cast<char*>(this) + Offset());
+    }
+
+    void DestroyElements(size_t constructed) {
+        if constexpr (!std::is_trivially_destructible_v<Element>) {
+            Element* elements = Elements();
+            while (constructed > 0) {
+                elements[--constructed].~Element();
+            }
+        }
+    }
+
+    void Free() {
+        this->~ArrayBlock();
+        if constexpr (kOverAligned) {
+            ::operator delete(this, std::align_val_t(kAlignment));
+        } else {
+            ::operator delete(this);
+        }
+    }
+};
+
+// `Alloc` for objects of type `T`
+template <typename Alloc, typename T>
+using ReboundAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+
+// Like `InlineBlock`, but the block is allocated, the object constructed and both freed through
+// `Alloc`. The allocator is stored rebound to the block; an empty one takes no space
+template <typename T, typename Alloc, typename Base = ControlBlockBase>
+struct AllocatedBlock
+    : Base,
+      private CompressedElement<ReboundAlloc<Alloc, AllocatedBlock<T, Alloc, Base>>, 0> {
+    using BlockAlloc = ReboundAlloc<Alloc, AllocatedBlock>;
+    using BlockTraits = std::allocator_traits<BlockAlloc>;
+    using ObjectAlloc = ReboundAlloc<Alloc, std::remove_cv_t<T>>;
+    using ObjectTraits = std::allocator_traits<ObjectAlloc>;
+    using Storage = CompressedElement<BlockAlloc, 0>;
+
+    alignas(T) char storage[sizeof(T)];
+
+    template <typename... Args>
+    static AllocatedBlock* Create(const Alloc& alloc, Args&&... args) {
+        BlockAlloc block_alloc(alloc);
+        AllocatedBlock* block = BlockTraits::allocate(block_alloc, 1);
+        try {
+            new (block) AllocatedBlock(block_alloc, std::forward<Args>(args)...);
+        } catch (...) {
+            BlockTraits::deallocate(block_alloc, block, 1);
+            throw;
+        }
+        return block;
+    }
+
+    static void* Manage(ControlBlockBase* base, BlockOp op) {
+        auto block = static_cast<AllocatedBlock*>(base);
+        switch (op) {
+            case BlockOp::kGetRawPtr:
+                return block->storage;
+            case BlockOp::kDestroy:
+                block->DestroyObject();
+                break;
+            case BlockOp::kDelete:
+                block->Deallocate();
+                break;
+            case BlockOp::kDestroyAndDelete:
+                block->DestroyObject();
+                block->Deallocate();
+                break;
+        }
+        return nullptr;
+    }
+
+private:
+    template <typename... Args>
+    AllocatedBlock(const BlockAlloc& alloc, Args&&... args) : Storage(alloc) {
+        ObjectAlloc object_alloc(alloc);
+        ObjectTraits::construct(object_alloc, Object(), std::forward<Args>(args)...);
+        this->manager = &Manage;
+    }
+
+    std::remove_cv_t<T>* Object() {
+        return reinterpret_cast<std::remove_cv_t<T>*>(storage);
+    }
+
+    void DestroyObject() {
+        ObjectAlloc object_alloc(Storage::GetVal());
+        ObjectTraits::destroy(object_alloc, Object());
     }
 
-    void Destroy() override {
-        if (!is_destroyed) {
-            strong_ref_cnt = 0;
-            is_destroyed = true;
-            reinterpret_cast<T*>(storage)->~T();
+    void Deallocate() {
+        BlockAlloc alloc(std::move(Storage::GetVal()));
+        this->~AllocatedBlock();
+        BlockTraits::deallocate(alloc, this, 1);
+    }
+};
+
+// Owns `ptr` and frees it with `deleter(ptr)`. The block itself is allocated through `Alloc`.
+// Stateless deleters and allocators take no space
+template <typename Y, typename Deleter, typename Alloc, typename Base = ControlBlockBase>
+struct DeleterBlock
+    : Base,
+      private CompressedElement<ReboundAlloc<Alloc, DeleterBlock<Y, Deleter, Alloc, Base>>, 0> {
+    using BlockAlloc = ReboundAlloc<Alloc, DeleterBlock>;
+    using BlockTraits = std::allocator_traits<BlockAlloc>;
+    using Storage = CompressedElement<BlockAlloc, 0>;
+
+    // The `CompressedPair` of unique/, as in `UniquePtr`
+    CompressedPair<Y*, Deleter> ptr_and_deleter;
+
+    // Calls `deleter(ptr)` if the block cannot be allocated or the deleter cannot be moved in
+    static DeleterBlock* Create(Y* ptr, Deleter&& deleter, const Alloc& alloc) {
+        BlockAlloc block_alloc(alloc);
+        DeleterBlock* block = nullptr;
+        try {
+            block = BlockTraits::allocate(block_alloc, 1);
+            return new (block) DeleterBlock(ptr, std::move(deleter), block_alloc);
+        } catch (...) {
+            if (block) {
+                BlockTraits::deallocate(block_alloc, block, 1);
+            }
+            deleter(ptr);
+            throw;
         }
     }
 
-    void* GetRawPtr() override {
-        return storage;
+    static void* Manage(ControlBlockBase* base, BlockOp op) {
+        auto block = static_cast<DeleterBlock*>(base);
+        switch (op) {
+            case BlockOp::kGetRawPtr:
+                return block->ptr_and_deleter.GetFirst();
+            case BlockOp::kDestroy:
+                block->DeleteObject();
+                break;
+            case BlockOp::kDelete:
+                block->Deallocate();
+                break;
+            case BlockOp::kDestroyAndDelete:
+                block->DeleteObject();
+                block->Deallocate();
+                break;
+        }
+        return nullptr;
+    }
+
+private:
+    DeleterBlock(Y* ptr, Deleter&& deleter, const BlockAlloc& alloc)
+        : Storage(alloc), ptr_and_deleter(ptr, std::move(deleter)) {
+        this->manager = &Manage;
+    }
+
+    void DeleteObject() {
+        ptr_and_deleter.GetSecond()(ptr_and_deleter.GetFirst());
+    }
+
+    void Deallocate() {
+        BlockAlloc alloc(std::move(Storage::GetVal()));
+        this->~DeleterBlock();
+        BlockTraits::deallocate(alloc, this, 1);
     }
 };
+
+// `SharedPtr<T>` takes a `Y*` from `new` or `new[]`: for an array `T` the elements must be of the
+// same type, up to cv-qualification, since `operator[]` steps by `sizeof(element_type)`
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
+template <typename Y, typename T>
+concept AdoptablePointer =
+    (!std::is_array_v<T> && std::is_convertible_v<Y*, T*>) ||
+    (std::is_unbounded_array_v<T> && std::is_convertible_v<Y (*)[], T*>) ||
+    (std::is_bounded_array_v<T> && std::is_convertible_v<Y (*)[std::extent_v<T>], T*>);
+
+// `SharedPtr<Y>` and `WeakPtr<Y>` convert to pointers to `T`, e.g. `Derived` to `Base` or `U[N]`
+// to `const U[]`, but neither `Derived[]` to `Base[]` nor `U` to `U[]`
+template <typename Y, typename T>
+concept CompatiblePointer =
+    std::is_convertible_v<Y*, T*> ||
+    (std::is_bounded_array_v<Y> && std::is_unbounded_array_v<T> &&
+     std::is_convertible_v<std::remove_extent_t<Y> (*)[], T*>);
+
 // https://en.cppreference.com/w/cpp/memory/shared_ptr
-template <typename T>
+template <typename T, typename Policy>
 class SharedPtr {
-    template <typename Y>
+    template <typename Y, typename OtherPolicy>
     friend class SharedPtr;
 
-    template <typename Y>
+    template <typename Y, typename OtherPolicy>
     friend class WeakPtr;
 
+    template <typename Ptr>
+    friend class AtomicPtrBase;
+
+    template <typename Y>
+    friend class HazardSharedPtr;
+
+    template <typename Y>
+    friend class EpochSharedPtr;
+
+    friend class CycleEdgeVisitor;
+
+    using Block = typename Policy::BlockBase;
+
 public:
+    using element_type = std::remove_extent_t<T>;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
@@ -114,20 +693,46 @@ public:
     SharedPtr(std::nullptr_t) : control_block_(nullptr), ptr_(nullptr) {
     }
 
+    // `SharedPtr<T[]>` takes a pointer from `new[]`
     template <typename Y>
+        requires AdoptablePointer<Y, T>
     explicit SharedPtr(Y* ptr)
-        : control_block_(new DefaultBlock<Y>(ptr)), ptr_(static_cast<T*>(ptr)) {
+        : control_block_(NewDefaultBlock(ptr)), ptr_(static_cast<element_type*>(ptr)) {
+        IncreaseStrongCounter();
+        TrackObject(ptr);
+
+        if constexpr (!std::is_array_v<T> && std::is_convertible_v<Y*, ESFTBase*>) {
+            InitWeakThis(ptr);
+        }
+    }
+
+    // `deleter(ptr)` runs instead of `delete`, e.g. `free` or `munmap` for adopted buffers
+    template <typename Y, typename Deleter>
+        requires AdoptablePointer<Y, T> && std::is_invocable_v<Deleter&, Y*>
+    SharedPtr(Y* ptr, Deleter deleter)
+        : SharedPtr(ptr, std::move(deleter), std::allocator<char>()) {
+    }
+
+    // The control block is allocated through `alloc`
+    template <typename Y, typename Deleter, typename Alloc>
+        requires AdoptablePointer<Y, T> && std::is_invocable_v<Deleter&, Y*>
+    SharedPtr(Y* ptr, Deleter deleter, const Alloc& alloc)
+        : control_block_(
+              DeleterBlock<Y, Deleter, Alloc, Block>::Create(ptr, std::move(deleter), alloc)),
+          ptr_(static_cast<element_type*>(ptr)) {
         IncreaseStrongCounter();
+        TrackObject(ptr);
 
-        if constexpr (std::is_convertible_v<Y*, ESFTBase*>) {
+        if constexpr (!std::is_array_v<T> && std::is_convertible_v<Y*, ESFTBase*>) {
             InitWeakThis(ptr);
         }
     }
 
-    SharedPtr(ControlBlockBase* block, T* ptr) : control_block_(block), ptr_(ptr) {
+    SharedPtr(Block* block, element_type* ptr) : control_block_(block), ptr_(ptr) {
         IncreaseStrongCounter();
+        TrackObject(ptr);
 
-        if constexpr (std::is_convertible_v<T*, ESFTBase*>) {
+        if constexpr (!std::is_array_v<T> && std::is_convertible_v<T*, ESFTBase*>) {
             InitWeakThis(ptr);
         }
     }
@@ -142,21 +747,38 @@ public:
     }
 
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other) : control_block_(other.control_block_), ptr_(other.ptr_) {
+        requires CompatiblePointer<Y, T>
+    SharedPtr(const SharedPtr<Y, Policy>& other)
+        : control_block_(other.control_block_), ptr_(other.ptr_) {
         IncreaseStrongCounter();
     }
 
     template <typename Y>
-    SharedPtr(SharedPtr<Y>&& other) noexcept
+        requires CompatiblePointer<Y, T>
+    SharedPtr(SharedPtr<Y, Policy>&& other) noexcept
         : control_block_(other.control_block_), ptr_(other.ptr_) {
         other.control_block_ = nullptr;
         other.ptr_ = nullptr;
     }
 
+    // Switch threading policy. The caller guarantees that no pointer of the old policy
+    // is used concurrently with the new one
+    template <typename Y, typename OtherPolicy>
+        requires CompatiblePointer<Y, T>
+    explicit SharedPtr(const SharedPtr<Y, OtherPolicy>& other)
+        : control_block_(other.control_block_), ptr_(other.ptr_) {
+        static_assert(std::is_same_v<typename OtherPolicy::BlockBase, Block>,
+                      "Policies with different control blocks are not convertible");
+        if (control_block_) {
+            control_block_->template AdoptThread<Policy>();
+        }
+        IncreaseStrongCounter();
+    }
+
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other, T* ptr) {
+    SharedPtr(const SharedPtr<Y, Policy>& other, element_type* ptr) {
         control_block_ = other.control_block_;
         IncreaseStrongCounter();
         ptr_ = ptr;
@@ -164,12 +786,13 @@ public:
 
     // Promote `WeakPtr`
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
-    explicit SharedPtr(const WeakPtr<T>& other)
+    explicit SharedPtr(const WeakPtr<T, Policy>& other)
         : control_block_(other.control_block_), ptr_(other.ptr_) {
-        if (control_block_->IsDestroyed()) {
+        if (!control_block_ || !control_block_->template TryIncStrongRef<Policy>()) {
+            control_block_ = nullptr;
+            ptr_ = nullptr;
             throw BadWeakPtr();
         }
-        IncreaseStrongCounter();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -210,29 +833,82 @@ public:
     }
 
     template <typename Y>
+        requires AdoptablePointer<Y, T>
     void Reset(Y* ptr) {
         *this = SharedPtr(ptr);
     }
 
+    template <typename Y, typename Deleter>
+        requires AdoptablePointer<Y, T> && std::is_invocable_v<Deleter&, Y*>
+    void Reset(Y* ptr, Deleter deleter) {
+        *this = SharedPtr(ptr, std::move(deleter));
+    }
+
     void Swap(SharedPtr& other) {
         std::swap(control_block_, other.control_block_);
         std::swap(ptr_, other.ptr_);
     }
 
+    // Writes `count` copies of this pointer to `out` with one update of the strong count, e.g.
+    // to fan one message out to many queues
+    template <typename OutputIt>
+    OutputIt ShareN(size_t count, OutputIt out) const {
+        if (control_block_ && count > 0) {
+            control_block_->template IncStrongRef<Policy>(count);
+        }
+        size_t written = 0;
+        try {
+            for (; written < count; ++written) {
+                *out++ = Adopt(control_block_, ptr_);
+            }
+        } catch (...) {
+            // The copy being written has released its own reference. This pointer still holds
+            // one, so the count does not drop to zero here
+            if (size_t unused = count - written - 1; control_block_ && unused > 0) {
+                control_block_->template DecStrongRef<Policy>(unused);
+            }
+            throw;
+        }
+        return out;
+    }
+
+    // Resets every pointer in [first, last). Runs of adjacent pointers to the same block take
+    // one update of the strong count, e.g. a queue that holds a fanned-out message many times
+    template <typename ForwardIt>
+    static void ReleaseBatch(ForwardIt first, ForwardIt last) {
+        while (first != last) {
+            Block* block = first->control_block_;
+            size_t count = 0;
+            for (; first != last && first->control_block_ == block; ++first) {
+                first->control_block_ = nullptr;
+                first->ptr_ = nullptr;
+                ++count;
+            }
+            if (block && block->template DecStrongRef<Policy>(count) == 0) {
+                block->template ReleaseObject<Policy>();
+            }
+        }
+    }
+
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Observers
 
-    T* Get() const {
+    element_type* Get() const {
         return ptr_;
     }
 
-    T& operator*() const {
+    element_type& operator*() const requires(!std::is_array_v<T>) {
         return *ptr_;
     }
 
-    T* operator->() const {
+    element_type* operator->() const requires(!std::is_array_v<T>) {
         return ptr_;
     }
+
+    element_type& operator[](std::ptrdiff_t index) const requires std::is_array_v<T> {
+        return ptr_[index];
+    }
+
     size_t UseCount() const {
         return GetStrongCounter();
     }
@@ -241,31 +917,70 @@ public:
         return ptr_ != nullptr;
     }
 
+    // Ownership order: pointers that share a control block are equivalent, whatever they point
+    // to, and stay so after the object has expired
+    // https://en.cppreference.com/w/cpp/memory/shared_ptr/owner_before
+    template <typename Y, typename OtherPolicy>
+    bool OwnerBefore(const SharedPtr<Y, OtherPolicy>& other) const {
+        return std::less<const void*>()(control_block_, other.control_block_);
+    }
+
+    template <typename Y, typename OtherPolicy>
+    bool OwnerBefore(const WeakPtr<Y, OtherPolicy>& other) const {
+        return std::less<const void*>()(control_block_, other.control_block_);
+    }
+
+    template <typename Y, typename OtherPolicy>
+    bool OwnerEqual(const SharedPtr<Y, OtherPolicy>& other) const {
+        return static_cast<const void*>(control_block_) == other.control_block_;
+    }
+
+    template <typename Y, typename OtherPolicy>
+    bool OwnerEqual(const WeakPtr<Y, OtherPolicy>& other) const {
+        return static_cast<const void*>(control_block_) == other.control_block_;
+    }
+
+    size_t OwnerHash() const {
+        return std::hash<const void*>()(control_block_);
+    }
+
 private:
-    ControlBlockBase* control_block_ = nullptr;
-    T* ptr_ = nullptr;
+    Block* control_block_ = nullptr;
+    element_type* ptr_ = nullptr;
+
+    template <typename Y>
+    static Block* NewDefaultBlock(Y* ptr) {
+        if constexpr (std::is_array_v<T>) {
+            return new DefaultBlock<Y[], Block>(ptr);
+        } else {
+            return new DefaultBlock<Y, Block>(ptr);
+        }
+    }
+
+    // Lets a block such as `CycleBlockBase` record the type of a new object
+    template <typename Y>
+    void TrackObject(Y* ptr) {
+        if constexpr (!std::is_array_v<T> && requires { control_block_->TrackObject(ptr); }) {
+            control_block_->TrackObject(ptr);
+        }
+    }
 
     template <typename Y>
     void InitWeakThis(EnableSharedFromThis<Y>* esft_block) {
+        static_assert(std::is_same_v<Block, ControlBlockBase>,
+                      "EnableSharedFromThis requires a policy with the default control block");
         esft_block->weak_this_ = WeakPtr<Y>(*this);
-        esft_block->weak_this_.MakeEsftPtr();
     }
 
     void IncreaseStrongCounter() {
         if (control_block_) {
-            control_block_->IncStrongRef();
+            control_block_->template IncStrongRef<Policy>();
         }
     }
 
     void DecreaseStrongCounter() {
-        if (control_block_) {
-            control_block_->DecStrongRef();
-            if (control_block_->GetStrongCounter() == 0) {
-                control_block_->Destroy();
-                if (control_block_->CanDeleteControlBlock()) {
-                    delete control_block_;
-                }
-            }
+        if (control_block_ && control_block_->template DecStrongRef<Policy>() == 0) {
+            control_block_->template ReleaseObject<Policy>();
         }
     }
 
@@ -275,19 +990,102 @@ private:
         }
         return 0;
     }
+
+    // Takes over a strong reference the caller has already counted
+    static SharedPtr Adopt(Block* block, element_type* ptr) {
+        SharedPtr result;
+        result.control_block_ = block;
+        result.ptr_ = ptr;
+        return result;
+    }
 };
 
-template <typename T, typename U>
-inline bool operator==(const SharedPtr<T>& left, const SharedPtr<U>& right) {
+// A `SharedPtr` is a pair of pointers to the heap, whatever the policy
+template <typename T, typename Policy>
+struct IsTriviallyRelocatable<SharedPtr<T, Policy>> : std::true_type {};
+
+template <typename T, typename P, typename U, typename Q>
+inline bool operator==(const SharedPtr<T, P>& left, const SharedPtr<U, Q>& right) {
     return left.Get() == right.Get();
 }
 
 // Allocate memory only once
-template <typename T, typename... Args>
-SharedPtr<T> MakeShared(Args&&... args) {
-    InlineBlock<T>* block = new InlineBlock<T>(std::forward<Args>(args)...);
+template <typename T, typename Policy = AtomicPolicy, typename... Args>
+    requires(!std::is_array_v<T>)
+SharedPtr<T, Policy> MakeShared(Args&&... args) {
+    auto block = new InlineBlock<T, typename Policy::BlockBase>(std::forward<Args>(args)...);
+    T* ptr = static_cast<T*>(block->GetRawPtr());
+    return SharedPtr<T, Policy>(block, ptr);
+}
+
+// Like `MakeShared<T>()`, but the object is default-initialized: a trivial `T` such as a large
+// buffer is left uninitialized instead of being zeroed
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/make_shared
+template <typename T, typename Policy = AtomicPolicy>
+    requires(!std::is_array_v<T>)
+SharedPtr<T, Policy> MakeSharedForOverwrite() {
+    auto block = new InlineBlock<T, typename Policy::BlockBase>(ForOverwriteTag{});
     T* ptr = static_cast<T*>(block->GetRawPtr());
-    return SharedPtr<T>(block, ptr);
+    return SharedPtr<T, Policy>(block, ptr);
+}
+
+// Common part of the array forms of `MakeShared` and `MakeSharedForOverwrite`
+template <typename T, typename Policy, bool kForOverwrite>
+SharedPtr<T, Policy> MakeSharedArray(size_t count) {
+    using Element = std::remove_extent_t<T>;
+    auto block = ArrayBlock<Element, typename Policy::BlockBase>::template Create<kForOverwrite>(
+        count);
+    auto ptr = static_cast<Element*>(block->GetRawPtr());
+    return SharedPtr<T, Policy>(block, ptr);
+}
+
+// `MakeShared<T[]>(count)` and `MakeShared<T[N]>()`: value-initialized elements that live in the
+// same allocation as the control block
+template <typename T, typename Policy = AtomicPolicy>
+    requires std::is_unbounded_array_v<T>
+SharedPtr<T, Policy> MakeShared(size_t count) {
+    return MakeSharedArray<T, Policy, false>(count);
+}
+
+template <typename T, typename Policy = AtomicPolicy>
+    requires std::is_bounded_array_v<T>
+SharedPtr<T, Policy> MakeShared() {
+    return MakeSharedArray<T, Policy, false>(std::extent_v<T>);
+}
+
+// Default-initialized elements, see `MakeSharedForOverwrite<T>()`
+template <typename T, typename Policy = AtomicPolicy>
+    requires std::is_unbounded_array_v<T>
+SharedPtr<T, Policy> MakeSharedForOverwrite(size_t count) {
+    return MakeSharedArray<T, Policy, true>(count);
+}
+
+template <typename T, typename Policy = AtomicPolicy>
+    requires std::is_bounded_array_v<T>
+SharedPtr<T, Policy> MakeSharedForOverwrite() {
+    return MakeSharedArray<T, Policy, true>(std::extent_v<T>);
+}
+
+// Warms up the pool of `MakeShared<T, Policy>` blocks, so that the next `count` of them do not
+// call the system allocator. A no-op unless `PooledBlocks<T>` is set
+template <typename T, typename Policy = AtomicPolicy>
+void ReserveShared(size_t count) {
+    using Block = InlineBlock<T, typename Policy::BlockBase>;
+    if constexpr (Block::kPooled) {
+        SizeClassPool<Block>::Reserve(count);
+    }
+}
+
+// `MakeShared` through an allocator, e.g. `std::pmr::polymorphic_allocator` over a request's
+// `std::pmr::monotonic_buffer_resource`. The block is freed through a copy of `alloc` once the
+// last `WeakPtr` is gone
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/allocate_shared
+template <typename T, typename Policy = AtomicPolicy, typename Alloc, typename... Args>
+SharedPtr<T, Policy> AllocateShared(const Alloc& alloc, Args&&... args) {
+    using Block = AllocatedBlock<T, Alloc, typename Policy::BlockBase>;
+    Block* block = Block::Create(alloc, std::forward<Args>(args)...);
+    T* ptr = static_cast<T*>(block->GetRawPtr());
+    return SharedPtr<T, Policy>(block, ptr);
 }
 
 // Look for usage examples in tests
@@ -295,7 +1093,7 @@ struct ESFTBase {};
 
 template <typename T>
 class EnableSharedFromThis : public ESFTBase {
-    template <typename Y>
+    template <typename Y, typename Policy>
     friend class SharedPtr;
 
 public:
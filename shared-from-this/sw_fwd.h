@@ -5,7 +5,11 @@
 // Instead of std::bad_weak_ptr
 class BadWeakPtr : public std::exception {};
 
-template <typename T>
+// Reference counting policies, see shared.h
+struct AtomicPolicy;
+struct SingleThreadedPolicy;
+
+template <typename T, typename Policy = AtomicPolicy>
 class SharedPtr;
 
 struct ESFTBase;
@@ -13,5 +17,14 @@ struct ESFTBase;
 template <typename T>
 class EnableSharedFromThis;
 
-template <typename T>
+template <typename T, typename Policy = AtomicPolicy>
 class WeakPtr;
+
+template <typename Ptr>
+class AtomicPtrBase;
+
+template <typename T>
+class HazardSharedPtr;
+
+template <typename T>
+class EpochSharedPtr;
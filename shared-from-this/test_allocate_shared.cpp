@@ -0,0 +1,164 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <catch.hpp>
+
+#include <cstddef>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Stats {
+    int allocations = 0;
+    int deallocations = 0;
+    size_t bytes = 0;
+};
+
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    Stats* stats;
+
+    explicit CountingAllocator(Stats* stats) : stats(stats) {
+    }
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) : stats(other.stats) {
+    }
+
+    T* allocate(size_t count) {
+        ++stats->allocations;
+        stats->bytes += count * sizeof(T);
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T* ptr, size_t count) {
+        ++stats->deallocations;
+        std::allocator<T>().deallocate(ptr, count);
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U>& other) const {
+        return stats == other.stats;
+    }
+};
+
+template <typename T>
+struct FailingAllocator {
+    using value_type = T;
+
+    FailingAllocator() = default;
+
+    template <typename U>
+    FailingAllocator(const FailingAllocator<U>&) {
+    }
+
+    T* allocate(size_t) {
+        throw std::bad_alloc();
+    }
+
+    void deallocate(T*, size_t) {
+    }
+
+    template <typename U>
+    bool operator==(const FailingAllocator<U>&) const {
+        return true;
+    }
+};
+
+struct Throwing {
+    Throwing() {
+        throw std::runtime_error("Throwing");
+    }
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("AllocateShared with a stateful allocator") {
+    Stats stats;
+    CountingAllocator<int> alloc(&stats);
+
+    auto sp = AllocateShared<int>(alloc, 42);
+    REQUIRE(*sp == 42);
+    REQUIRE(sp.UseCount() == 1);
+    REQUIRE(stats.allocations == 1);
+    REQUIRE(stats.bytes == sizeof(AllocatedBlock<int, CountingAllocator<int>>));
+
+    WeakPtr<int> weak(sp);
+    SharedPtr<int> copy = sp;
+    sp.Reset();
+    copy.Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE(stats.deallocations == 0);
+
+    weak.Reset();
+    REQUIRE(stats.deallocations == 1);
+}
+
+TEST_CASE("AllocateShared with an empty allocator") {
+    static_assert(sizeof(AllocatedBlock<int, std::allocator<int>>) == sizeof(InlineBlock<int>));
+    static_assert(sizeof(AllocatedBlock<int, std::allocator<char>>) == sizeof(InlineBlock<int>));
+    static_assert(sizeof(AllocatedBlock<int, CountingAllocator<int>>) >
+                  sizeof(InlineBlock<int>));
+
+    auto sp = AllocateShared<std::string>(std::allocator<char>(), 3, 'a');
+    REQUIRE(*sp == "aaa");
+}
+
+TEST_CASE("AllocateShared with a memory resource") {
+    alignas(std::max_align_t) std::byte buffer[1024];
+    std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer),
+                                                 std::pmr::null_memory_resource());
+    std::pmr::polymorphic_allocator<std::byte> alloc(&resource);
+
+    auto number = AllocateShared<int>(alloc, 42);
+    auto inside = [&buffer](const void* ptr) {
+        return ptr >= buffer && ptr < buffer + sizeof(buffer);
+    };
+    REQUIRE(inside(number.Get()));
+
+    // The string gets the same resource through uses-allocator construction
+    auto string = AllocateShared<std::pmr::string>(alloc, 100, 'x');
+    REQUIRE(inside(string.Get()));
+    REQUIRE(inside(string->data()));
+    REQUIRE(string->get_allocator().resource() == &resource);
+}
+
+TEST_CASE("AllocateShared frees the block on exception") {
+    Stats stats;
+    CountingAllocator<Throwing> alloc(&stats);
+
+    REQUIRE_THROWS_AS(AllocateShared<Throwing>(alloc), std::runtime_error);
+    REQUIRE(stats.allocations == 1);
+    REQUIRE(stats.deallocations == 1);
+}
+
+TEST_CASE("Deleter and allocator") {
+    Stats stats;
+    int deleted = 0;
+    auto deleter = [&deleted](int* ptr) {
+        ++deleted;
+        delete ptr;
+    };
+
+    SharedPtr<int> sp(new int(42), deleter, CountingAllocator<int>(&stats));
+    WeakPtr<int> weak(sp);
+    REQUIRE(stats.allocations == 1);
+    sp.Reset();
+    REQUIRE(deleted == 1);
+    REQUIRE(stats.deallocations == 0);
+    weak.Reset();
+    REQUIRE(stats.deallocations == 1);
+
+    // The pointer is not leaked if the block cannot be allocated
+    REQUIRE_THROWS_AS(SharedPtr<int>(new int(1), deleter, FailingAllocator<int>()),
+                      std::bad_alloc);
+    REQUIRE(deleted == 2);
+}
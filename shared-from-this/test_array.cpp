@@ -0,0 +1,160 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Tracked {
+    inline static std::vector<int> destroyed;
+    inline static int next_id = 0;
+    inline static int throw_at = -1;
+
+    int id;
+
+    Tracked() : id(next_id++) {
+        if (id == throw_at) {
+            throw std::runtime_error("Tracked");
+        }
+    }
+
+    ~Tracked() {
+        destroyed.push_back(id);
+    }
+
+    static void Clear() {
+        destroyed.clear();
+        next_id = 0;
+        throw_at = -1;
+    }
+};
+
+struct alignas(64) Line {
+    char bytes[64];
+};
+
+struct Base {
+    int x = 0;
+};
+
+struct Derived : Base {
+    int y = 0;
+};
+
+template <typename Ptr, typename Y>
+concept Resettable = requires(Ptr ptr, Y* raw) { ptr.Reset(raw); };
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("SharedPtr of an array from new[]") {
+    Tracked::Clear();
+    {
+        SharedPtr<Tracked[]> sp(new Tracked[3]);
+        REQUIRE(sp[2].id == 2);
+        SharedPtr<Tracked[]> copy = sp;
+        REQUIRE(copy.Get() == &sp[0]);
+    }
+    REQUIRE(Tracked::destroyed.size() == 3);
+
+    SharedPtr<int[]> numbers;
+    numbers.Reset(new int[4]{1, 2, 3, 4});
+    numbers[3] += 10;
+    REQUIRE(numbers[3] == 14);
+}
+
+TEST_CASE("MakeShared of an array") {
+    SECTION("One allocation") {
+        EXPECT_ONE_ALLOCATION({
+            auto sp = MakeShared<int[]>(1000);
+            REQUIRE(sp[0] == 0);
+            REQUIRE(sp[999] == 0);
+        });
+        EXPECT_ONE_ALLOCATION(REQUIRE(MakeShared<double[16]>()[15] == 0.0));
+    }
+
+    SECTION("Reverse destruction") {
+        Tracked::Clear();
+        auto sp = MakeShared<Tracked[]>(4);
+        WeakPtr<Tracked[]> weak(sp);
+        REQUIRE(sp[3].id == 3);
+
+        sp.Reset();
+        REQUIRE(Tracked::destroyed == std::vector<int>{3, 2, 1, 0});
+        REQUIRE(weak.Expired());
+    }
+
+    SECTION("Faulty element constructor") {
+        Tracked::Clear();
+        Tracked::throw_at = 2;
+        REQUIRE_THROWS_AS(MakeShared<Tracked[3]>(), std::runtime_error);
+        REQUIRE(Tracked::destroyed == std::vector<int>{1, 0});
+    }
+
+    SECTION("Aligned elements") {
+        auto sp = MakeShared<Line[]>(3);
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(reinterpret_cast<std::uintptr_t>(&sp[i]) % 64 == 0);
+        }
+    }
+
+    SECTION("Const elements") {
+        SharedPtr<const int[]> lookup = MakeShared<int[]>(8);
+        REQUIRE(lookup[7] == 0);
+
+        auto empty = MakeShared<const int[]>(0);
+        REQUIRE(empty.UseCount() == 1);
+    }
+
+    SECTION("Too many elements") {
+        REQUIRE_THROWS_AS(MakeShared<int[]>(SIZE_MAX / 2), std::bad_array_new_length);
+    }
+}
+
+TEST_CASE("MakeSharedForOverwrite of an array") {
+    EXPECT_ONE_ALLOCATION({
+        auto buffer = MakeSharedForOverwrite<unsigned char[]>(64 * 1024);
+        buffer[64 * 1024 - 1] = 42;
+        REQUIRE(buffer[64 * 1024 - 1] == 42);
+    });
+
+    Tracked::Clear();
+    auto tracked = MakeSharedForOverwrite<Tracked[2]>();
+    REQUIRE(tracked[1].id == 1);
+}
+
+TEST_CASE("Array pointers do not convert between element types") {
+    // `operator[]` of a `Base[]` would step over `Derived` elements by `sizeof(Base)`
+    static_assert(!std::is_constructible_v<SharedPtr<Base[]>, Derived*>);
+    static_assert(!std::is_constructible_v<SharedPtr<Base[]>, SharedPtr<Derived[]>>);
+    static_assert(!std::is_convertible_v<SharedPtr<Derived[]>, SharedPtr<Base[]>>);
+    static_assert(!std::is_convertible_v<WeakPtr<Derived[]>, WeakPtr<Base[]>>);
+    static_assert(!std::is_convertible_v<SharedPtr<int>, SharedPtr<int[]>>);
+    static_assert(!std::is_convertible_v<SharedPtr<int[]>, SharedPtr<int>>);
+    static_assert(!std::is_constructible_v<SharedPtr<int>, int (*)[4]>);
+    static_assert(!Resettable<SharedPtr<Base[]>, Derived>);
+    static_assert(Resettable<SharedPtr<Base>, Derived>);
+
+    static_assert(std::is_convertible_v<SharedPtr<int[]>, SharedPtr<const int[]>>);
+    static_assert(std::is_convertible_v<SharedPtr<int[4]>, SharedPtr<int[]>>);
+    static_assert(std::is_convertible_v<WeakPtr<int[]>, WeakPtr<const int[]>>);
+    static_assert(std::is_convertible_v<SharedPtr<Derived>, SharedPtr<Base>>);
+
+    SharedPtr<Derived[]> derived(new Derived[4]);
+    derived[1].x = 1;
+    SharedPtr<const Derived[]> readonly = derived;
+    REQUIRE(readonly[1].x == 1);
+
+    SharedPtr<int[]> numbers = MakeShared<int[4]>();
+    REQUIRE(numbers.UseCount() == 1);
+}
@@ -0,0 +1,212 @@
+#include "atomic_shared.h"
+
+#include <common/counted.h>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Base {
+    int base = 1;
+};
+
+struct Other {
+    int other = 2;
+};
+
+struct Derived : Base, Other {};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("AtomicSharedPtr basics") {
+    AtomicSharedPtr<std::string> empty;
+    REQUIRE(empty.IsLockFree());
+    REQUIRE(empty.Load().Get() == nullptr);
+
+    auto a = MakeShared<std::string>("a");
+    AtomicSharedPtr<std::string> atomic(a);
+    {
+        auto loaded = atomic.Load();
+        REQUIRE(loaded == a);
+        REQUIRE(*loaded == "a");
+    }
+
+    auto b = MakeShared<std::string>("b");
+    auto old = atomic.Exchange(b);
+    REQUIRE(old == a);
+    REQUIRE(a.UseCount() == 2);
+    old.Reset();
+    REQUIRE(a.UseCount() == 1);
+
+    atomic.Store(nullptr);
+    REQUIRE(atomic.Load().Get() == nullptr);
+    REQUIRE(b.UseCount() == 1);
+}
+
+TEST_CASE("AtomicSharedPtr compare exchange") {
+    auto a = MakeShared<int>(1);
+    auto b = MakeShared<int>(2);
+    AtomicSharedPtr<int> atomic(a);
+
+    SharedPtr<int> expected = b;
+    REQUIRE(!atomic.CompareExchangeStrong(expected, MakeShared<int>(3)));
+    REQUIRE(expected == a);
+
+    REQUIRE(atomic.CompareExchangeStrong(expected, b));
+    REQUIRE(atomic.Load() == b);
+    expected.Reset();
+    REQUIRE(a.UseCount() == 1);
+
+    expected = b;
+    while (!atomic.CompareExchangeWeak(expected, a)) {
+        REQUIRE(expected == b);
+    }
+    REQUIRE(atomic.Load() == a);
+}
+
+TEST_CASE("AtomicSharedPtr aliasing") {
+    auto derived = MakeShared<Derived>();
+    SharedPtr<Other> other = derived;
+    REQUIRE(static_cast<void*>(other.Get()) != static_cast<void*>(derived.Get()));
+
+    AtomicSharedPtr<Other> atomic(other);
+    auto loaded = atomic.Load();
+    REQUIRE(loaded == other);
+    REQUIRE(loaded->other == 2);
+
+    SharedPtr<Other> expected = other;
+    REQUIRE(atomic.CompareExchangeStrong(expected, nullptr));
+    loaded.Reset();
+    expected.Reset();
+    REQUIRE(derived.UseCount() == 2);
+}
+
+TEST_CASE("AtomicSharedPtr compare exchange of boxed values") {
+    constexpr int kThreads = 4;
+    constexpr int kSteps = 20'000;
+
+    // Every element but the first is an aliasing value, stored in a box. Each swap moves the
+    // value one element on, so a swap against a stale value would lose steps
+    auto elements = MakeShared<int[]>(kThreads * kSteps + 2);
+    auto element = [&elements](ptrdiff_t index) {
+        return SharedPtr<int>(elements, &elements[index]);
+    };
+    AtomicSharedPtr<int> atomic(element(1));
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&]() {
+            for (int step = 0; step < kSteps; ++step) {
+                auto expected = atomic.Load();
+                while (!atomic.CompareExchangeWeak(expected,
+                                                   element(expected.Get() - &elements[0] + 1))) {
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(atomic.Load().Get() == &elements[kThreads * kSteps + 1]);
+    atomic.Store(nullptr);
+    REQUIRE(elements.UseCount() == 1);
+}
+
+TEST_CASE("AtomicSharedPtr refill") {
+    auto sp = MakeShared<int>(42);
+    AtomicSharedPtr<int> atomic(sp);
+
+    std::vector<SharedPtr<int>> loaded;
+    for (int i = 0; i < 100'000; ++i) {
+        loaded.push_back(atomic.Load());
+    }
+    loaded.clear();
+
+    atomic.Store(nullptr);
+    REQUIRE(sp.UseCount() == 1);
+}
+
+TEST_CASE("AtomicSharedPtr many holders of one object") {
+    // More than a full 16-bit batch per holder would fit into the strong count
+    constexpr size_t kHolders = 40'000;
+
+    auto sp = MakeShared<int>(42);
+    std::vector<AtomicSharedPtr<int>> holders(kHolders);
+    for (auto& holder : holders) {
+        holder.Store(sp);
+    }
+    REQUIRE(*holders.back().Load() == 42);
+    REQUIRE(sp.UseCount() > kHolders);
+
+    holders.clear();
+    REQUIRE(sp.UseCount() == 1);
+}
+
+TEST_CASE("AtomicSharedPtr concurrent readers and writers") {
+    constexpr int kReaders = 6;
+    constexpr int kWriters = 2;
+    std::atomic<int> destroyed = 0;
+    std::atomic<int> created = 1;
+    std::atomic<bool> saw_wrong = false;
+
+    {
+        AtomicSharedPtr<Counted> atomic(MakeShared<Counted>(&destroyed, 0));
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kReaders; ++i) {
+            threads.emplace_back([&]() {
+                for (int j = 0; j < 100'000; ++j) {
+                    auto loaded = atomic.Load();
+                    if (loaded->value < 0 || loaded->value >= 10'000) {
+                        saw_wrong = true;
+                    }
+                }
+            });
+        }
+        for (int i = 0; i < kWriters; ++i) {
+            threads.emplace_back([&, i]() {
+                for (int j = 0; j < 10'000; ++j) {
+                    ++created;
+                    if (j % 2 == 0) {
+                        atomic.Store(MakeShared<Counted>(&destroyed, j));
+                    } else {
+                        auto expected = atomic.Load();
+                        atomic.CompareExchangeStrong(expected, MakeShared<Counted>(&destroyed, i));
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    REQUIRE(!saw_wrong);
+    REQUIRE(destroyed == created);
+}
+
+TEST_CASE("AtomicWeakPtr") {
+    auto sp = MakeShared<int>(42);
+    AtomicWeakPtr<int> atomic(WeakPtr<int>{sp});
+
+    auto weak = atomic.Load();
+    REQUIRE(*weak.Lock() == 42);
+
+    WeakPtr<int> expected = weak;
+    REQUIRE(atomic.CompareExchangeStrong(expected, WeakPtr<int>()));
+    REQUIRE(atomic.Load().Expired());
+
+    atomic.Store(WeakPtr<int>{sp});
+    sp.Reset();
+    REQUIRE(atomic.Load().Expired());
+    REQUIRE(weak.Expired());
+}
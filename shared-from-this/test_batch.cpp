@@ -0,0 +1,149 @@
+#include "biased.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <common/counted.h>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Throws on the `limit`-th write
+struct ThrowingOutput {
+    std::vector<SharedPtr<int>>* out;
+    size_t limit;
+
+    ThrowingOutput& operator*() {
+        return *this;
+    }
+
+    ThrowingOutput& operator++(int) {
+        return *this;
+    }
+
+    ThrowingOutput& operator=(SharedPtr<int> value) {
+        if (out->size() + 1 == limit) {
+            throw std::runtime_error("ThrowingOutput");
+        }
+        out->push_back(std::move(value));
+        return *this;
+    }
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("ShareN") {
+    auto sp = MakeShared<int>(42);
+
+    std::vector<SharedPtr<int>> copies;
+    sp.ShareN(1000, std::back_inserter(copies));
+    REQUIRE(copies.size() == 1000);
+    REQUIRE(sp.UseCount() == 1001);
+    REQUIRE(copies[999] == sp);
+
+    SharedPtr<int> slots[3];
+    REQUIRE(sp.ShareN(3, slots) == slots + 3);
+    REQUIRE(*slots[2] == 42);
+    REQUIRE(sp.UseCount() == 1004);
+
+    SharedPtr<int> empty;
+    empty.ShareN(2, slots);
+    REQUIRE(!slots[0]);
+    REQUIRE(sp.UseCount() == 1002);
+
+    sp.ShareN(0, slots);
+    REQUIRE(sp.UseCount() == 1002);
+}
+
+TEST_CASE("ShareN returns the references it did not write") {
+    auto sp = MakeShared<int>(42);
+    std::vector<SharedPtr<int>> copies;
+    REQUIRE_THROWS_AS(sp.ShareN(10, ThrowingOutput{&copies, 4}), std::runtime_error);
+    REQUIRE(copies.size() == 3);
+    REQUIRE(sp.UseCount() == 4);
+}
+
+TEST_CASE("ReleaseBatch") {
+    std::atomic<int> destroyed = 0;
+    SharedPtr<Counted> a(new Counted(&destroyed));
+    SharedPtr<Counted> b(new Counted(&destroyed));
+    WeakPtr<Counted> weak_b(b);
+
+    std::vector<SharedPtr<Counted>> batch = {a, a, b, nullptr, b, b, a};
+    b.Reset();
+    SharedPtr<Counted>::ReleaseBatch(batch.begin(), batch.end());
+    for (const auto& ptr : batch) {
+        REQUIRE(!ptr);
+    }
+    REQUIRE(destroyed == 1);
+    REQUIRE(weak_b.Expired());
+    REQUIRE(a.UseCount() == 1);
+
+    SharedPtr<Counted>::ReleaseBatch(&a, &a + 1);
+    REQUIRE(destroyed == 2);
+}
+
+TEST_CASE("Fan-out across threads") {
+    constexpr int kThreads = 4;
+    constexpr size_t kPerThread = 1000;
+
+    std::atomic<int> destroyed = 0;
+
+    SECTION("Atomic") {
+        SharedPtr<Counted> message(new Counted(&destroyed));
+        std::vector<SharedPtr<Counted>> queues[kThreads];
+        for (auto& queue : queues) {
+            message.ShareN(kPerThread, std::back_inserter(queue));
+        }
+        message.Reset();
+
+        std::vector<std::thread> threads;
+        for (auto& queue : queues) {
+            threads.emplace_back([&queue]() {
+                SharedPtr<Counted>::ReleaseBatch(queue.begin(), queue.end());
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    SECTION("Biased") {
+        using Ptr = SharedPtr<Counted, BiasedPolicy>;
+        Ptr message(new Counted(&destroyed));
+        std::vector<Ptr> queues[kThreads];
+        for (int i = 1; i < kThreads; ++i) {
+            message.ShareN(kPerThread, std::back_inserter(queues[i]));
+        }
+        // Counted in the shared counter, so that the owner later releases more references than
+        // its biased count holds
+        std::thread([&message, &queue = queues[0]]() {
+            message.ShareN(kPerThread, std::back_inserter(queue));
+        }).join();
+
+        std::vector<std::thread> threads;
+        for (int i = 1; i < kThreads; ++i) {
+            threads.emplace_back([&queue = queues[i]]() {
+                Ptr::ReleaseBatch(queue.begin(), queue.end());
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        Ptr::ReleaseBatch(queues[0].begin(), queues[0].end());
+        REQUIRE(destroyed == 0);
+        message.Reset();
+    }
+
+    REQUIRE(destroyed == 1);
+}
@@ -0,0 +1,163 @@
+#include "biased.h"
+
+#include <common/counted.h>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+using BiasedPtr = SharedPtr<int, BiasedPolicy>;
+using BiasedWeakPtr = WeakPtr<int, BiasedPolicy>;
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Biased owner thread") {
+    static_assert(sizeof(BiasedPtr) == sizeof(SharedPtr<int>));
+
+    auto sp = MakeShared<int, BiasedPolicy>(42);
+    BiasedWeakPtr weak(sp);
+    {
+        BiasedPtr a = sp;
+        BiasedPtr b(a);
+        REQUIRE(sp.UseCount() == 3);
+        REQUIRE(*weak.Lock() == 42);
+        REQUIRE(weak.UseCount() == 3);
+    }
+    REQUIRE(sp.UseCount() == 1);
+    REQUIRE(!weak.Expired());
+
+    sp.Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE(weak.UseCount() == 0);
+    REQUIRE(weak.Lock().Get() == nullptr);
+}
+
+TEST_CASE("Biased release on another thread") {
+    std::atomic<int> destroyed = 0;
+    SharedPtr<Counted, BiasedPolicy> sp(new Counted(&destroyed));
+    auto copy = sp;
+
+    SECTION("Owner drains last") {
+        std::thread([copy = std::move(copy)]() mutable { copy.Reset(); }).join();
+        REQUIRE(sp.UseCount() == 1);
+        sp.Reset();
+        REQUIRE(destroyed == 1);
+    }
+
+    SECTION("Remote drops last, owner merges") {
+        sp.Reset();
+        std::thread([copy = std::move(copy)]() mutable { copy.Reset(); }).join();
+        REQUIRE(destroyed == 0);
+        MergeBiasedReferences();
+        REQUIRE(destroyed == 1);
+    }
+
+    SECTION("Remote copies") {
+        std::thread([&sp]() {
+            for (int i = 0; i < 1000; ++i) {
+                SharedPtr<Counted, BiasedPolicy> local(sp);
+            }
+        }).join();
+        REQUIRE(sp.UseCount() == 2);
+        copy.Reset();
+        sp.Reset();
+        REQUIRE(destroyed == 1);
+    }
+}
+
+TEST_CASE("Biased owner exits first") {
+    std::atomic<int> destroyed = 0;
+    std::vector<SharedPtr<Counted, BiasedPolicy>> copies;
+
+    std::thread([&]() {
+        SharedPtr<Counted, BiasedPolicy> sp(new Counted(&destroyed));
+        for (int i = 0; i < 4; ++i) {
+            copies.push_back(sp);
+        }
+    }).join();
+
+    REQUIRE(copies.front().UseCount() == 4);
+    copies.clear();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Biased concurrent release") {
+    constexpr int kThreads = 8;
+
+    for (int round = 0; round < 200; ++round) {
+        std::atomic<int> destroyed = 0;
+        std::vector<SharedPtr<Counted, BiasedPolicy>> copies(kThreads);
+        {
+            SharedPtr<Counted, BiasedPolicy> sp(new Counted(&destroyed));
+            for (auto& copy : copies) {
+                copy = sp;
+            }
+        }
+
+        std::vector<std::thread> threads;
+        for (int i = 1; i < kThreads; ++i) {
+            threads.emplace_back([&copies, i]() {
+                for (int j = 0; j < 100; ++j) {
+                    auto local = copies[i];
+                }
+                copies[i].Reset();
+            });
+        }
+        copies[0].Reset();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        MergeBiasedReferences();
+        REQUIRE(destroyed == 1);
+    }
+}
+
+TEST_CASE("Biased Lock from another thread") {
+    for (int round = 0; round < 200; ++round) {
+        auto sp = MakeShared<int, BiasedPolicy>(42);
+        BiasedWeakPtr weak(sp);
+        std::atomic<bool> saw_wrong = false;
+
+        std::thread remote([&weak, &saw_wrong]() {
+            for (int i = 0; i < 1'000; ++i) {
+                if (auto locked = weak.Lock(); locked && *locked != 42) {
+                    saw_wrong = true;
+                }
+            }
+        });
+        sp.Reset();
+        remote.join();
+
+        MergeBiasedReferences();
+        REQUIRE(!saw_wrong);
+        REQUIRE(weak.Expired());
+        REQUIRE(weak.Lock().Get() == nullptr);
+    }
+}
+
+TEST_CASE("Biased Lock after the last release on another thread") {
+    std::atomic<int> destroyed = 0;
+    SharedPtr<Counted, BiasedPolicy> sp(new Counted(&destroyed, 42));
+    WeakPtr<Counted, BiasedPolicy> weak(sp);
+
+    std::thread([sp = std::move(sp)]() mutable { sp.Reset(); }).join();
+    // Still queued for the merge, yet dead on every thread
+    REQUIRE(destroyed == 0);
+    REQUIRE(weak.Expired());
+    REQUIRE(weak.UseCount() == 0);
+    REQUIRE(weak.Lock().Get() == nullptr);
+    std::thread([&weak]() { REQUIRE(weak.Lock().Get() == nullptr); }).join();
+
+    MergeBiasedReferences();
+    REQUIRE(destroyed == 1);
+    REQUIRE(weak.Lock().Get() == nullptr);
+}
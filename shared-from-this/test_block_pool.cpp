@@ -0,0 +1,188 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <common/counted.h>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// A size no control block uses, so that other tests do not share the pool
+using Pool = BlockPool<200>;
+
+struct Message {
+    int id;
+    char payload[20];
+};
+
+// As large as `Message`, so that both blocks share a size class with and without `NDEBUG`
+struct Tick {
+    double price;
+    double volume;
+    int size;
+};
+
+struct alignas(64) Line {
+    int value = 0;
+};
+
+struct alignas(64) PooledLine {
+    int value = 0;
+};
+
+}  // namespace
+
+template <>
+struct PooledBlocks<Message> : std::true_type {};
+
+template <>
+struct PooledBlocks<Tick> : std::true_type {};
+
+template <>
+struct PooledBlocks<PooledLine> : std::true_type {};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Block pool reuses slots") {
+    static_assert(Pool::kSlotSize % alignof(std::max_align_t) == 0);
+
+    void* first = Pool::Allocate();
+    Pool::Deallocate(first);
+    REQUIRE(Pool::Allocate() == first);
+
+    std::vector<void*> slots;
+    for (size_t i = 0; i < Pool::kMagazineSize * 3; ++i) {
+        slots.push_back(Pool::Allocate());
+    }
+    slots.push_back(first);
+    REQUIRE(std::set<void*>(slots.begin(), slots.end()).size() == slots.size());
+    for (void* slot : slots) {
+        Pool::Deallocate(slot);
+    }
+}
+
+TEST_CASE("Block pool hands magazines over between threads") {
+    constexpr size_t kCount = Pool::kMagazineSize * 4;
+
+    std::vector<void*> slots(kCount);
+    std::thread([&slots]() {
+        for (void*& slot : slots) {
+            slot = Pool::Allocate();
+        }
+    }).join();
+
+    // Freed here, so whole magazines go to the depot
+    for (void* slot : slots) {
+        Pool::Deallocate(slot);
+    }
+
+    std::set<void*> freed(slots.begin(), slots.end());
+    size_t reused = 0;
+    std::thread([&]() {
+        std::vector<void*> again(kCount);
+        for (void*& slot : again) {
+            slot = Pool::Allocate();
+            reused += freed.count(slot);
+        }
+        for (void* slot : again) {
+            Pool::Deallocate(slot);
+        }
+    }).join();
+    REQUIRE(reused > 0);
+}
+
+TEST_CASE("Default blocks released on other threads") {
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 1'000;
+
+    std::atomic<int> destroyed = 0;
+    std::vector<SharedPtr<Counted>> strong;
+    std::vector<WeakPtr<Counted>> weak;
+    for (int i = 0; i < kThreads * kPerThread; ++i) {
+        strong.emplace_back(new Counted(&destroyed));
+        weak.emplace_back(strong.back());
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&, i]() {
+            for (int j = i * kPerThread; j < (i + 1) * kPerThread; ++j) {
+                strong[j].Reset();
+                SharedPtr<Counted> churn(new Counted(&destroyed));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(destroyed == 2 * kThreads * kPerThread);
+    // The last weak references free the blocks into the main thread's cache
+    weak.clear();
+}
+
+TEST_CASE("MakeShared aligns over-aligned types") {
+    static_assert(!InlineBlock<PooledLine>::kPooled);
+
+    std::vector<SharedPtr<Line>> lines;
+    std::vector<SharedPtr<PooledLine>> pooled;
+    for (int i = 0; i < 1'000; ++i) {
+        lines.push_back(MakeShared<Line>());
+        pooled.push_back(MakeShared<PooledLine>());
+        REQUIRE(reinterpret_cast<uintptr_t>(lines.back().Get()) % alignof(Line) == 0);
+        REQUIRE(reinterpret_cast<uintptr_t>(pooled.back().Get()) % alignof(PooledLine) == 0);
+    }
+}
+
+// Without the pool every block comes from the system allocator
+#ifndef SHARED_NO_BLOCK_POOL
+
+TEST_CASE("MakeShared takes pooled blocks from the size class") {
+    using Block = InlineBlock<Message>;
+    static_assert(Block::kPooled);
+    static_assert(!InlineBlock<int>::kPooled);
+    static_assert(std::is_same_v<SizeClassPool<Block>, SizeClassPool<InlineBlock<Tick>>>);
+
+    auto message = MakeShared<Message>(Message{7, "hello"});
+    WeakPtr<Message> weak(message);
+    REQUIRE(message->id == 7);
+    auto address = reinterpret_cast<const char*>(message.Get());
+
+    // The slot goes back to the pool with the last weak reference
+    message.Reset();
+    weak.Reset();
+    auto slot = static_cast<char*>(SizeClassPool<Block>::Allocate());
+    REQUIRE(slot <= address);
+    REQUIRE(address < slot + SizeClassPool<Block>::kSlotSize);
+
+    SizeClassPool<Block>::Deallocate(slot);
+    REQUIRE(MakeShared<Tick>(Tick{1.5, 100.0, 3})->size == 3);
+}
+
+TEST_CASE("ReserveShared keeps MakeShared off the system allocator") {
+    constexpr size_t kCount = 1'000;
+
+    ReserveShared<Message>(kCount);
+    size_t slabs = SizeClassPool<InlineBlock<Message>>::SlabCount();
+    int last = -1;
+    std::thread([&last]() {
+        std::vector<SharedPtr<Message>> messages;
+        messages.reserve(kCount);
+        for (size_t i = 0; i < kCount; ++i) {
+            messages.push_back(MakeShared<Message>(Message{static_cast<int>(i), ""}));
+        }
+        last = messages.back()->id;
+    }).join();
+    REQUIRE(last == static_cast<int>(kCount) - 1);
+    REQUIRE(SizeClassPool<InlineBlock<Message>>::SlabCount() == slabs);
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include "cow.h"
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Config {
+    std::string name;
+    std::vector<int> limits;
+};
+
+using ConfigCow = Cow<Config>;
+
+const Config* Address(const ConfigCow& config) {
+    return &config.Read();
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Cow copies share the object") {
+    ConfigCow config(Config{"base", {1, 2, 3}});
+    REQUIRE(config.IsUnique());
+
+    ConfigCow copy = config;
+    REQUIRE(Address(copy) == Address(config));
+    REQUIRE(config.UseCount() == 2);
+    REQUIRE(copy->name == "base");
+    REQUIRE((*copy).limits.size() == 3);
+    EXPECT_ZERO_ALLOCATIONS(REQUIRE(copy.Read().limits[1] == 2));
+}
+
+TEST_CASE("Cow clones on the first shared write") {
+    ConfigCow config(Config{"base", {1, 2, 3}});
+    ConfigCow copy = config;
+
+    copy.Write().name = "copy";
+    REQUIRE(Address(copy) != Address(config));
+    REQUIRE(config->name == "base");
+    REQUIRE(copy->name == "copy");
+    REQUIRE(config.IsUnique());
+    REQUIRE(copy.IsUnique());
+
+    // Unique now, so later writes stay in place
+    const Config* address = Address(copy);
+    EXPECT_ZERO_ALLOCATIONS(copy.Write().limits[0] = 42);
+    REQUIRE(Address(copy) == address);
+    REQUIRE(copy->limits[0] == 42);
+    REQUIRE(config->limits[0] == 1);
+}
+
+TEST_CASE("Cow mutation scopes") {
+    ConfigCow config(std::in_place, "base", std::vector<int>{1});
+    ConfigCow copy = config;
+
+    {
+        auto mutation = copy.Mutate();
+        mutation->name = "edited";
+        mutation->limits.push_back(2);
+        (*mutation).limits.push_back(3);
+    }
+    REQUIRE(copy->limits == std::vector<int>{1, 2, 3});
+    REQUIRE(config->limits == std::vector<int>{1});
+
+    ConfigCow other = copy;
+    size_t size = other.Mutate([](Config& value) {
+        value.limits.clear();
+        return value.limits.size();
+    });
+    REQUIRE(size == 0);
+    REQUIRE(copy->limits.size() == 3);
+}
+
+TEST_CASE("Cow adopts a SharedPtr") {
+    auto ptr = MakeShared<Config>(Config{"shared", {}});
+    ConfigCow config(std::move(ptr));
+    REQUIRE(config->name == "shared");
+    REQUIRE(config.IsUnique());
+
+    SharedPtr<const Config> shared = config.Share();
+    REQUIRE(!config.IsUnique());
+    config.Write().name = "written";
+    REQUIRE(shared->name == "shared");
+
+    Cow<int> number;
+    REQUIRE(*number == 0);
+}
+
+TEST_CASE("Cow copies written on other threads") {
+    constexpr int kThreads = 4;
+
+    ConfigCow config(Config{"base", std::vector<int>(100, 1)});
+    std::vector<ConfigCow> copies(kThreads, config);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&copies, i]() {
+            for (int& limit : copies[i].Write().limits) {
+                limit = i;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(config->limits[99] == 1);
+    for (int i = 0; i < kThreads; ++i) {
+        REQUIRE(copies[i]->limits[99] == i);
+    }
+}
@@ -0,0 +1,215 @@
+#include "cycle.h"
+
+#include <catch.hpp>
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Node;
+
+using NodePtr = SharedPtr<Node, CyclePolicy>;
+
+struct Node {
+    Node(int* destroyed) : destroyed(destroyed) {
+    }
+
+    ~Node() {
+        ++*destroyed;
+    }
+
+    int* destroyed;
+    std::vector<NodePtr> edges;
+};
+
+// Never traced
+struct Leaf {
+    Leaf(int* destroyed) : destroyed(destroyed) {
+    }
+
+    ~Leaf() {
+        ++*destroyed;
+    }
+
+    int* destroyed;
+};
+
+struct Holder {
+    Holder(int* destroyed) : node(destroyed) {
+    }
+
+    Node node;
+    SharedPtr<Leaf, CyclePolicy> leaf;
+};
+
+NodePtr MakeNode(int* destroyed) {
+    return MakeShared<Node, CyclePolicy>(destroyed);
+}
+
+// `count` nodes, each pointing to the next one and the last one to the first
+std::vector<NodePtr> MakeRing(size_t count, int* destroyed) {
+    std::vector<NodePtr> nodes;
+    for (size_t i = 0; i < count; ++i) {
+        nodes.push_back(MakeNode(destroyed));
+    }
+    for (size_t i = 0; i < count; ++i) {
+        nodes[i]->edges.push_back(nodes[(i + 1) % count]);
+    }
+    return nodes;
+}
+
+}  // namespace
+
+template <>
+struct CycleEdges<Node> {
+    template <typename Visitor>
+    static void ForEach(Node& node, Visitor& visit) {
+        for (NodePtr& edge : node.edges) {
+            visit(edge);
+        }
+    }
+};
+
+template <>
+struct CycleEdges<Holder> {
+    template <typename Visitor>
+    static void ForEach(Holder& holder, Visitor& visit) {
+        CycleEdges<Node>::ForEach(holder.node, visit);
+        visit(holder.leaf);
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Collect a ring") {
+    static_assert(HasCycleEdges<Node>);
+    static_assert(!HasCycleEdges<Leaf>);
+
+    int destroyed = 0;
+    WeakPtr<Node, CyclePolicy> weak;
+    {
+        auto ring = MakeRing(3, &destroyed);
+        weak = ring[0];
+    }
+    REQUIRE(destroyed == 0);
+    REQUIRE(CycleCollector::Current()->CandidateCount() == 3);
+
+    REQUIRE(CollectCycles() == 3);
+    REQUIRE(destroyed == 3);
+    REQUIRE(weak.Expired());
+    REQUIRE(CycleCollector::Current()->CandidateCount() == 0);
+    REQUIRE(CollectCycles() == 0);
+}
+
+TEST_CASE("Self loop") {
+    int destroyed = 0;
+    {
+        auto node = MakeNode(&destroyed);
+        node->edges.push_back(node);
+        node->edges.push_back(node);
+    }
+    REQUIRE(CollectCycles() == 1);
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Live cycles are kept") {
+    int destroyed = 0;
+    auto ring = MakeRing(4, &destroyed);
+    NodePtr outside = ring[2];
+    ring.clear();
+
+    REQUIRE(CollectCycles() == 0);
+    REQUIRE(destroyed == 0);
+    REQUIRE(outside.UseCount() == 2);
+
+    // Found again once the last outside reference is dropped
+    outside.Reset();
+    REQUIRE(CollectCycles() == 4);
+    REQUIRE(destroyed == 4);
+}
+
+TEST_CASE("Objects kept by a live object are kept") {
+    int destroyed = 0;
+    NodePtr live = MakeNode(&destroyed);
+    auto ring = MakeRing(2, &destroyed);
+    // A dead ring points to a live node, which points to a dead one
+    ring[0]->edges.push_back(live);
+    NodePtr kept = MakeNode(&destroyed);
+    live->edges.push_back(kept);
+    kept.Reset();
+    ring.clear();
+
+    REQUIRE(CollectCycles() == 2);
+    REQUIRE(destroyed == 2);
+    REQUIRE(live.UseCount() == 1);
+    REQUIRE(live->edges[0].UseCount() == 1);
+}
+
+TEST_CASE("Leaves of a dead cycle are destroyed with it") {
+    int destroyed = 0;
+    {
+        auto holder = MakeShared<Holder, CyclePolicy>(&destroyed);
+        holder->leaf = MakeShared<Leaf, CyclePolicy>(&destroyed);
+        NodePtr node(holder, &holder->node);
+        node->edges.push_back(node);
+    }
+    REQUIRE(CollectCycles() == 2);
+    REQUIRE(destroyed == 2);
+}
+
+TEST_CASE("Plain releases are not candidates") {
+    int destroyed = 0;
+    {
+        SharedPtr<Leaf, CyclePolicy> leaf(new Leaf(&destroyed));
+        auto copy = leaf;
+    }
+    {
+        auto node = MakeNode(&destroyed);
+    }
+    REQUIRE(destroyed == 2);
+    REQUIRE(CycleCollector::Current()->CandidateCount() == 0);
+}
+
+TEST_CASE("CollectCycles with a root budget") {
+    int destroyed = 0;
+    MakeRing(1, &destroyed);
+    MakeRing(1, &destroyed);
+    MakeRing(1, &destroyed);
+    REQUIRE(CycleCollector::Current()->CandidateCount() == 3);
+
+    REQUIRE(CollectCycles(1) == 1);
+    REQUIRE(CycleCollector::Current()->CandidateCount() == 2);
+    REQUIRE(CollectCycles(2) == 2);
+    REQUIRE(destroyed == 3);
+}
+
+TEST_CASE("Collect a long cycle") {
+    constexpr size_t kCount = 100'000;
+
+    int destroyed = 0;
+    MakeRing(kCount, &destroyed);
+    REQUIRE(CollectCycles() == kCount);
+    REQUIRE(destroyed == static_cast<int>(kCount));
+}
+
+TEST_CASE("Release during collection") {
+    int destroyed = 0;
+    NodePtr survivor = MakeNode(&destroyed);
+    {
+        auto ring = MakeRing(2, &destroyed);
+        ring[1]->edges.push_back(survivor);
+        survivor->edges.push_back(MakeNode(&destroyed));
+        survivor->edges[0]->edges.push_back(survivor);
+    }
+    // The ring's destructors release `survivor`, which makes it a candidate again
+    NodePtr last_outside = survivor;
+    survivor.Reset();
+    REQUIRE(CollectCycles() == 2);
+    REQUIRE(CycleCollector::Current()->CandidateCount() == 1);
+
+    last_outside.Reset();
+    REQUIRE(CollectCycles() == 2);
+    REQUIRE(destroyed == 4);
+}
@@ -0,0 +1,147 @@
+#include "deferred.h"
+
+#include <common/counted.h>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+using DeferredPtr = SharedPtr<Counted, DeferredPolicy>;
+
+struct Logged {
+    Logged(std::vector<int>* order, int value) : order(order), value(value) {
+    }
+
+    ~Logged() {
+        order->push_back(value);
+    }
+
+    std::vector<int>* order;
+    int value;
+};
+
+// Releases a deferred child from its destructor
+struct Node {
+    Node(std::atomic<int>* destroyed, SharedPtr<Node, DeferredPolicy> child = nullptr)
+        : counted(destroyed), child(std::move(child)) {
+    }
+
+    Counted counted;
+    SharedPtr<Node, DeferredPolicy> child;
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Deferred release waits for Drain") {
+    DeferredQueue& queue = DeferredQueue::Global();
+    REQUIRE(queue.Depth() == 0);
+    uint64_t destroyed_before = queue.DestroyedCount();
+
+    std::atomic<int> destroyed = 0;
+    auto sp = MakeShared<Counted, DeferredPolicy>(&destroyed, 1);
+    WeakPtr<Counted, DeferredPolicy> weak(sp);
+    DeferredPtr adopted(new Counted(&destroyed, 2));
+
+    sp.Reset();
+    adopted.Reset();
+    REQUIRE(destroyed == 0);
+    REQUIRE(queue.Depth() == 2);
+    // The object is still alive, but it is already expired
+    REQUIRE(weak.Expired());
+    REQUIRE(weak.Lock().Get() == nullptr);
+
+    REQUIRE(queue.Drain() == 2);
+    REQUIRE(destroyed == 2);
+    REQUIRE(queue.Depth() == 0);
+    REQUIRE(queue.DestroyedCount() == destroyed_before + 2);
+    REQUIRE(queue.Drain() == 0);
+}
+
+TEST_CASE("Deferred objects are destroyed in release order") {
+    std::vector<int> order;
+    std::vector<SharedPtr<Logged, DeferredPolicy>> pointers;
+    for (int i = 0; i < 5; ++i) {
+        pointers.push_back(MakeShared<Logged, DeferredPolicy>(&order, i));
+    }
+    pointers[3].Reset();
+    pointers[0].Reset();
+    pointers[4].Reset();
+    pointers[1].Reset();
+    pointers[2].Reset();
+
+    DeferredQueue::Global().Drain();
+    REQUIRE(order == std::vector<int>{3, 0, 4, 1, 2});
+}
+
+TEST_CASE("Drain destroys objects released by deferred destructors") {
+    DeferredQueue& queue = DeferredQueue::Global();
+    queue.ResetMaxDepth();
+
+    std::atomic<int> destroyed = 0;
+    SharedPtr<Node, DeferredPolicy> chain;
+    for (int i = 0; i < 100; ++i) {
+        chain = MakeShared<Node, DeferredPolicy>(&destroyed, std::move(chain));
+    }
+    chain.Reset();
+    REQUIRE(queue.Depth() == 1);
+
+    REQUIRE(queue.Drain() == 100);
+    REQUIRE(destroyed == 100);
+    REQUIRE(queue.MaxDepth() == 1);
+}
+
+TEST_CASE("Reclaimer destroys objects released on other threads") {
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 1'000;
+
+    DeferredQueue& queue = DeferredQueue::Global();
+    uint64_t pushed_before = queue.PushedCount();
+    queue.StartReclaimer();
+    queue.StartReclaimer();
+    REQUIRE(queue.IsReclaimerRunning());
+
+    std::atomic<int> destroyed = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&destroyed]() {
+            for (int j = 0; j < kPerThread; ++j) {
+                auto sp = MakeShared<Counted, DeferredPolicy>(&destroyed, j);
+                DeferredPtr copy = sp;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    queue.Flush();
+    REQUIRE(destroyed == kThreads * kPerThread);
+    REQUIRE(queue.Depth() == 0);
+    REQUIRE(queue.PushedCount() == pushed_before + kThreads * kPerThread);
+
+    // Stopping destroys what was released meanwhile
+    auto sp = MakeShared<Counted, DeferredPolicy>(&destroyed);
+    sp.Reset();
+    queue.StopReclaimer();
+    REQUIRE_FALSE(queue.IsReclaimerRunning());
+    REQUIRE(destroyed == kThreads * kPerThread + 1);
+    REQUIRE(queue.Depth() == 0);
+}
+
+TEST_CASE("Deferred queue without reclaimer") {
+    DeferredQueue queue;
+    REQUIRE(queue.Drain() == 0);
+    queue.Flush();
+    queue.StartReclaimer();
+    queue.StopReclaimer();
+    REQUIRE(queue.Depth() == 0);
+    REQUIRE(queue.MaxDepth() == 0);
+}
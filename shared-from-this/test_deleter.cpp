@@ -0,0 +1,115 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <catch.hpp>
+
+#include <unique/compressed_pair.h>
+#include <unique/deleters.h>
+
+#include <cstdlib>
+#include <stdexcept>
+#include <type_traits>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct FreeDeleter {
+    void operator()(void* ptr) const {
+        std::free(ptr);
+    }
+};
+
+// A move that throws, as copying some state might
+struct ThrowingMoveDeleter {
+    int* calls;
+
+    explicit ThrowingMoveDeleter(int* calls) : calls(calls) {
+    }
+
+    ThrowingMoveDeleter(ThrowingMoveDeleter&&) {
+        throw std::runtime_error("ThrowingMoveDeleter");
+    }
+
+    void operator()(int* ptr) const {
+        ++*calls;
+        delete ptr;
+    }
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Stateless deleters take no space") {
+    auto lambda = [](int* ptr) { delete ptr; };
+    using Lambda = decltype(lambda);
+
+    static_assert(sizeof(DeleterBlock<int, Lambda, std::allocator<char>>) ==
+                  sizeof(DefaultBlock<int>));
+    static_assert(sizeof(DeleterBlock<int, FreeDeleter, std::allocator<char>>) ==
+                  sizeof(DefaultBlock<int>));
+    static_assert(sizeof(DeleterBlock<int, CopyableDeleter<int>, std::allocator<char>>) >
+                  sizeof(DefaultBlock<int>));
+
+    // The same pair as `UniquePtr` uses
+    static_assert(std::is_same_v<
+                  decltype(DeleterBlock<int, FreeDeleter, std::allocator<char>>::ptr_and_deleter),
+                  CompressedPair<int*, FreeDeleter>>);
+
+    SharedPtr<int> sp(new int(42), lambda);
+    REQUIRE(*sp == 42);
+}
+
+TEST_CASE("Buffers from malloc") {
+    auto buffer = static_cast<char*>(std::malloc(4096));
+    SharedPtr<char[]> sp(buffer, FreeDeleter());
+    sp[4095] = 'x';
+    REQUIRE(sp.Get() == buffer);
+
+    SharedPtr<char[]> copy = sp;
+    sp.Reset(static_cast<char*>(std::malloc(16)), FreeDeleter());
+    REQUIRE(copy[4095] == 'x');
+    REQUIRE(copy.UseCount() == 1);
+}
+
+TEST_CASE("Stateful deleters") {
+    int calls = 0;
+    auto counting = [&calls](int* ptr) {
+        ++calls;
+        delete ptr;
+    };
+
+    SECTION("Called once, when the last SharedPtr is gone") {
+        SharedPtr<int> sp(new int(1), counting);
+        WeakPtr<int> weak(sp);
+        SharedPtr<int> copy = sp;
+        sp.Reset();
+        REQUIRE(calls == 0);
+        copy.Reset();
+        REQUIRE(calls == 1);
+        REQUIRE(weak.Expired());
+    }
+
+    SECTION("Move-only deleter") {
+        SharedPtr<int> sp(new int(2), Deleter<int>(7));
+        SharedPtr<int[]> array(new int[3]{1, 2, 3}, Deleter<int[]>(8));
+        REQUIRE(array[2] == 3);
+    }
+
+    SECTION("Copyable deleter") {
+        CopyableDeleter<int> deleter(5);
+        SharedPtr<int> first(new int(3), deleter);
+        SharedPtr<int> second(new int(4), deleter);
+        REQUIRE(deleter.GetTag() == 5);
+        REQUIRE(*first + *second == 7);
+    }
+}
+
+TEST_CASE("Deleter called if the block cannot be built") {
+    int calls = 0;
+    REQUIRE_THROWS_AS(
+        SharedPtr<int>(new int(1), ThrowingMoveDeleter(&calls), std::allocator<char>()),
+        std::runtime_error);
+    REQUIRE(calls == 1);
+}
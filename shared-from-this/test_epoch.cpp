@@ -0,0 +1,214 @@
+#include "epoch.h"
+
+#include <common/counted.h>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+using EpochPtr = SharedPtr<int, EpochPolicy>;
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Epoch guard keeps a replaced object") {
+    std::atomic<int> destroyed = 0;
+    EpochSharedPtr<Counted> source(MakeShared<Counted, EpochPolicy>(&destroyed, 1));
+    EpochDomain& domain = EpochDomain::Global();
+    domain.SetScanThreshold(1);
+
+    std::atomic<int> step = 0;
+    int seen = 0;
+    std::thread reader([&]() {
+        EpochGuard guard;
+        Counted* counted = source.Get();
+        step = 1;
+        step.notify_one();
+        step.wait(1);
+        seen = counted->value;
+    });
+
+    step.wait(0);
+    // Retiring tries to advance the epoch, but the reader holds it back
+    source.Store(MakeShared<Counted, EpochPolicy>(&destroyed, 2));
+    REQUIRE(destroyed == 0);
+    REQUIRE(domain.Pending() == 1);
+
+    step = 2;
+    step.notify_one();
+    reader.join();
+    REQUIRE(seen == 1);
+
+    domain.Synchronize();
+    REQUIRE(domain.Pending() == 0);
+    REQUIRE(destroyed == 1);
+
+    source.Store(nullptr);
+    domain.Synchronize();
+    domain.SetScanThreshold(EpochDomain::kDefaultScanThreshold);
+    REQUIRE(destroyed == 2);
+}
+
+TEST_CASE("Epoch Load") {
+    EpochSharedPtr<int> empty;
+    REQUIRE(empty.Load().Get() == nullptr);
+
+    auto sp = MakeShared<int, EpochPolicy>(42);
+    EpochSharedPtr<int> source(sp);
+    REQUIRE(sp.UseCount() == 2);
+    {
+        EpochPtr loaded = source.Load();
+        REQUIRE(loaded == sp);
+        REQUIRE(sp.UseCount() == 3);
+    }
+    {
+        EpochGuard guard;
+        REQUIRE(*source.Get() == 42);
+    }
+
+    EpochPtr old = source.Exchange(EpochPtr());
+    REQUIRE(old == sp);
+    REQUIRE(sp.UseCount() == 2);
+    REQUIRE(source.Load().Get() == nullptr);
+}
+
+TEST_CASE("Retired object is expired before it is destroyed") {
+    std::atomic<int> destroyed = 0;
+    SharedPtr<Counted, EpochPolicy> sp(new Counted(&destroyed));
+    WeakPtr<Counted, EpochPolicy> weak(sp);
+
+    sp.Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE(weak.Lock().Get() == nullptr);
+
+    EpochDomain::Global().Synchronize();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Quiescent thread") {
+    std::atomic<int> destroyed = 0;
+    EpochSharedPtr<Counted> source(MakeShared<Counted, EpochPolicy>(&destroyed, 1));
+    EpochDomain& domain = EpochDomain::Global();
+    domain.SetScanThreshold(1);
+
+    std::atomic<int> step = 0;
+    int seen = 0;
+    std::thread reader([&]() {
+        domain.Online();
+        Counted* counted = source.Get();
+        step = 1;
+        step.notify_one();
+        step.wait(1);
+        seen = counted->value;
+        while (step != 3) {
+            domain.Quiescent();
+        }
+        domain.Offline();
+    });
+
+    step.wait(0);
+    source.Store(MakeShared<Counted, EpochPolicy>(&destroyed, 2));
+    REQUIRE(destroyed == 0);
+
+    // The reader keeps passing quiescent points, so the epoch advances without it going offline
+    step = 2;
+    step.notify_one();
+    domain.Synchronize();
+    REQUIRE(destroyed == 1);
+
+    step = 3;
+    reader.join();
+    REQUIRE(seen == 1);
+
+    source.Store(nullptr);
+    domain.Synchronize();
+    domain.SetScanThreshold(EpochDomain::kDefaultScanThreshold);
+    REQUIRE(destroyed == 2);
+}
+
+TEST_CASE("Retire bound") {
+    EpochDomain& domain = EpochDomain::Global();
+    domain.Synchronize();
+    domain.SetScanThreshold(4);
+    domain.SetRetireBound(16);
+
+    std::atomic<int> destroyed = 0;
+    size_t max_pending = 0;
+    for (int i = 0; i < 1'000; ++i) {
+        MakeShared<Counted, EpochPolicy>(&destroyed);
+        max_pending = std::max(max_pending, domain.Pending());
+    }
+    REQUIRE(max_pending <= 16);
+
+    domain.Synchronize();
+    REQUIRE(destroyed == 1'000);
+    domain.SetScanThreshold(EpochDomain::kDefaultScanThreshold);
+    domain.SetRetireBound(EpochDomain::kDefaultRetireBound);
+}
+
+TEST_CASE("Concurrent epoch readers") {
+    constexpr int kReaders = 4;
+    constexpr int kWriters = 2;
+
+    std::atomic<int> destroyed = 0;
+    std::atomic<int> created = 1;
+    std::atomic<bool> saw_wrong = false;
+    std::atomic<bool> done = false;
+    EpochSharedPtr<Counted> source(MakeShared<Counted, EpochPolicy>(&destroyed, 0));
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kReaders; ++i) {
+        threads.emplace_back([&, i]() {
+            if (i % 2) {
+                EpochDomain::Global().Online();
+            }
+            while (!done) {
+                if (i % 2) {
+                    if (source.Get()->value >= 10'000) {
+                        saw_wrong = true;
+                    }
+                    EpochDomain::Global().Quiescent();
+                } else {
+                    EpochGuard guard;
+                    if (source.Get()->value >= 10'000) {
+                        saw_wrong = true;
+                    }
+                }
+                if (source.Load()->value < 0) {
+                    saw_wrong = true;
+                }
+            }
+            if (i % 2) {
+                EpochDomain::Global().Offline();
+            }
+        });
+    }
+    for (int i = 0; i < kWriters; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 10'000; ++j) {
+                ++created;
+                source.Store(MakeShared<Counted, EpochPolicy>(&destroyed, j));
+            }
+        });
+    }
+
+    for (int i = kReaders; i < kReaders + kWriters; ++i) {
+        threads[i].join();
+    }
+    done = true;
+    for (int i = 0; i < kReaders; ++i) {
+        threads[i].join();
+    }
+
+    source.Store(nullptr);
+    EpochDomain::Global().Synchronize();
+    REQUIRE(!saw_wrong);
+    REQUIRE(destroyed == created);
+}
@@ -0,0 +1,151 @@
+#include "hazard.h"
+
+#include <common/counted.h>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+using HazardPtr = SharedPtr<int, HazardPolicy>;
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Hazard pointer keeps a replaced object") {
+    std::atomic<int> destroyed = 0;
+    HazardSharedPtr<Counted> source(MakeShared<Counted, HazardPolicy>(&destroyed, 1));
+
+    HazardPointer hazard;
+    Counted* protected_ptr = hazard.Protect(source);
+    REQUIRE(protected_ptr->value == 1);
+
+    source.Store(MakeShared<Counted, HazardPolicy>(&destroyed, 2));
+    HazardDomain::Global().Reclaim();
+    REQUIRE(destroyed == 0);
+    REQUIRE(protected_ptr->value == 1);
+
+    hazard.Reset();
+    HazardDomain::Global().Reclaim();
+    REQUIRE(destroyed == 1);
+    REQUIRE(hazard.Protect(source)->value == 2);
+
+    hazard.Reset();
+    source.Store(nullptr);
+    HazardDomain::Global().Reclaim();
+    REQUIRE(destroyed == 2);
+}
+
+TEST_CASE("Hazard Load") {
+    HazardSharedPtr<int> empty;
+    REQUIRE(empty.Load().Get() == nullptr);
+
+    auto sp = MakeShared<int, HazardPolicy>(42);
+    HazardSharedPtr<int> source(sp);
+    REQUIRE(sp.UseCount() == 2);
+    {
+        HazardPtr loaded = source.Load();
+        REQUIRE(loaded == sp);
+        REQUIRE(sp.UseCount() == 3);
+    }
+    REQUIRE(sp.UseCount() == 2);
+
+    HazardPtr old = source.Exchange(HazardPtr());
+    REQUIRE(old == sp);
+    REQUIRE(sp.UseCount() == 2);
+    REQUIRE(source.Load().Get() == nullptr);
+}
+
+TEST_CASE("Retired object is expired") {
+    std::atomic<int> destroyed = 0;
+    SharedPtr<Counted, HazardPolicy> sp(new Counted(&destroyed));
+    WeakPtr<Counted, HazardPolicy> weak(sp);
+    HazardSharedPtr<Counted> source(sp);
+
+    HazardPointer hazard;
+    hazard.Protect(source);
+    source.Store(nullptr);
+    sp.Reset();
+
+    REQUIRE(weak.Expired());
+    REQUIRE(weak.Lock().Get() == nullptr);
+    REQUIRE(destroyed == 0);
+
+    hazard.Reset();
+    HazardDomain::Global().Reclaim();
+    REQUIRE(destroyed == 1);
+    REQUIRE(weak.Expired());
+}
+
+TEST_CASE("Scan threshold") {
+    HazardDomain& domain = HazardDomain::Global();
+    domain.Reclaim();
+    domain.SetScanThreshold(16);
+    size_t threshold = domain.ScanThreshold();
+    REQUIRE(threshold >= 16);
+
+    std::atomic<int> destroyed = 0;
+    const int count = static_cast<int>(threshold) * 4;
+    for (int i = 0; i < count; ++i) {
+        MakeShared<Counted, HazardPolicy>(&destroyed);
+    }
+    REQUIRE(count - destroyed < static_cast<int>(threshold));
+
+    domain.Reclaim();
+    REQUIRE(destroyed == count);
+    domain.SetScanThreshold(HazardDomain::kDefaultScanThreshold);
+}
+
+TEST_CASE("Concurrent hazard readers") {
+    constexpr int kReaders = 4;
+    constexpr int kWriters = 2;
+
+    std::atomic<int> destroyed = 0;
+    std::atomic<int> created = 1;
+    std::atomic<bool> saw_wrong = false;
+    std::atomic<bool> done = false;
+    HazardSharedPtr<Counted> source(MakeShared<Counted, HazardPolicy>(&destroyed, 0));
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kReaders; ++i) {
+        threads.emplace_back([&]() {
+            HazardPointer hazard;
+            while (!done) {
+                Counted* counted = hazard.Protect(source);
+                if (counted->value < 0 || counted->value >= 10'000) {
+                    saw_wrong = true;
+                }
+                if (source.Load()->value < 0) {
+                    saw_wrong = true;
+                }
+            }
+        });
+    }
+    for (int i = 0; i < kWriters; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 10'000; ++j) {
+                ++created;
+                source.Store(MakeShared<Counted, HazardPolicy>(&destroyed, j));
+            }
+        });
+    }
+
+    for (int i = kReaders; i < kReaders + kWriters; ++i) {
+        threads[i].join();
+    }
+    done = true;
+    for (int i = 0; i < kReaders; ++i) {
+        threads[i].join();
+    }
+
+    source.Store(nullptr);
+    HazardDomain::Global().Reclaim();
+    REQUIRE(!saw_wrong);
+    REQUIRE(destroyed == created);
+}
@@ -0,0 +1,137 @@
+#include "intern_pool.h"
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct StringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view value) const {
+        return std::hash<std::string_view>()(value);
+    }
+};
+
+struct StringEqual {
+    using is_transparent = void;
+
+    bool operator()(std::string_view left, std::string_view right) const {
+        return left == right;
+    }
+};
+
+using SymbolPool = InternPool<std::string, StringHash, StringEqual>;
+
+// Every value lands in the same bucket
+struct CollidingHash {
+    size_t operator()(int) const {
+        return 7;
+    }
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Intern equal values once") {
+    InternPool<std::string> pool;
+    auto first = pool.Intern(std::string("symbol"));
+    auto second = pool.Intern(std::string("symbol"));
+    auto other = pool.Intern(std::string("other"));
+
+    REQUIRE(first.Get() == second.Get());
+    REQUIRE(first.Get() != other.Get());
+    REQUIRE(*first == "symbol");
+    REQUIRE(first.UseCount() == 2);
+    REQUIRE(pool.Size() == 2);
+}
+
+TEST_CASE("Intern hits do not allocate") {
+    SymbolPool pool;
+    auto symbol = pool.Intern(std::string_view("a symbol long enough to live on the heap"));
+    EXPECT_ZERO_ALLOCATIONS({
+        auto again = pool.Intern(std::string_view("a symbol long enough to live on the heap"));
+        REQUIRE(again.Get() == symbol.Get());
+    });
+}
+
+TEST_CASE("Intern keys of another type need transparent functors") {
+    static_assert(InternKey<const char*, std::string, StringHash, StringEqual>);
+    static_assert(InternKey<const std::string&, std::string, std::hash<std::string>,
+                            std::equal_to<std::string>>);
+    static_assert(!InternKey<const char*, std::string, std::hash<std::string>,
+                             std::equal_to<std::string>>);
+    static_assert(!InternKey<std::string_view, std::string, std::hash<std::string>,
+                             std::equal_to<>>);
+
+    SymbolPool pool;
+    const char* name = "a symbol long enough to live on the heap";
+    auto symbol = pool.Intern(name);
+    EXPECT_ZERO_ALLOCATIONS({
+        auto again = pool.Intern(name);
+        REQUIRE(again.Get() == symbol.Get());
+    });
+}
+
+TEST_CASE("Unused interned values are dropped") {
+    InternPool<int, CollidingHash> pool;
+    WeakPtr<const int> weak;
+    {
+        auto one = pool.Intern(1);
+        weak = one;
+        auto two = pool.Intern(2);
+        REQUIRE(*pool.Intern(2) == 2);
+        REQUIRE(pool.Size() == 2);
+    }
+    REQUIRE(weak.Expired());
+    REQUIRE(pool.Size() == 2);
+
+    // The lookup erases the expired entries it passes
+    auto three = pool.Intern(3);
+    REQUIRE(pool.Size() == 1);
+
+    three.Reset();
+    REQUIRE(pool.SweepAll() == 1);
+    REQUIRE(pool.Size() == 0);
+}
+
+TEST_CASE("Intern from many threads") {
+    constexpr int kThreads = 8;
+    constexpr int kValues = 1'000;
+
+    InternPool<int> pool;
+    std::vector<std::vector<SharedPtr<const int>>> interned(kThreads);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&pool, &interned, i]() {
+            for (int round = 0; round < 3; ++round) {
+                interned[i].clear();
+                for (int value = 0; value < kValues; ++value) {
+                    interned[i].push_back(pool.Intern(value));
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (int i = 1; i < kThreads; ++i) {
+        for (int value = 0; value < kValues; ++value) {
+            REQUIRE(interned[i][value].Get() == interned[0][value].Get());
+        }
+    }
+    REQUIRE(interned[0][42].UseCount() == kThreads);
+    interned.clear();
+    pool.SweepAll();
+    REQUIRE(pool.Size() == 0);
+}
@@ -0,0 +1,96 @@
+#include "padded.h"
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Counter {
+    int value = 0;
+};
+
+struct alignas(64) Aligned {
+    int value = 0;
+};
+
+bool OnCacheLine(const void* ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) % kCacheLineSize == 0;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Padded blocks keep the object off the counter line") {
+    REQUIRE(sizeof(InlineBlock<Counter, PaddedBlockBase>) == 2 * kCacheLineSize);
+
+    std::vector<SharedPtr<Counter, PaddedPolicy>> counters;
+    for (int i = 0; i < 16; ++i) {
+        counters.push_back(MakeShared<Counter, PaddedPolicy>());
+        REQUIRE(OnCacheLine(counters.back().Get()));
+    }
+
+    auto array = MakeShared<int[], PaddedPolicy>(3);
+    REQUIRE(OnCacheLine(array.Get()));
+    REQUIRE(array[2] == 0);
+}
+
+TEST_CASE("Padded blocks of adopted pointers") {
+    SharedPtr<Counter, PaddedPolicy> adopted(new Counter{1});
+    SharedPtr<Counter, PaddedPolicy> deleted(new Counter{2}, std::default_delete<Counter>());
+    auto allocated = AllocateShared<Counter, PaddedPolicy>(std::allocator<Counter>(), 3);
+    REQUIRE(adopted->value + deleted->value + allocated->value == 6);
+    REQUIRE(OnCacheLine(allocated.Get()));
+
+    WeakPtr<Counter, PaddedPolicy> weak = adopted;
+    REQUIRE(weak.Lock()->value == 1);
+    adopted.Reset();
+    REQUIRE(weak.Expired());
+}
+
+TEST_CASE("Over-aligned objects are aligned") {
+    for (int i = 0; i < 16; ++i) {
+        auto inline_object = MakeShared<Aligned>();
+        SharedPtr<Aligned> adopted(new Aligned);
+        auto array = MakeShared<Aligned[]>(2);
+        REQUIRE(OnCacheLine(inline_object.Get()));
+        REQUIRE(OnCacheLine(adopted.Get()));
+        REQUIRE(OnCacheLine(&array[1]));
+    }
+}
+
+TEST_CASE("Padded pointers copied on many threads") {
+    constexpr int kThreads = 4;
+    constexpr int kCopies = 10'000;
+
+    std::vector<SharedPtr<Counter, PaddedPolicy>> counters;
+    for (int i = 0; i < kThreads; ++i) {
+        counters.push_back(MakeShared<Counter, PaddedPolicy>());
+    }
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&counters, i]() {
+            for (int copy = 0; copy < kCopies; ++copy) {
+                auto mine = counters[i];
+                auto shared = counters[0];
+                ++mine->value;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (const auto& counter : counters) {
+        REQUIRE(counter.UseCount() == 1);
+        REQUIRE(counter->value == kCopies);
+    }
+}
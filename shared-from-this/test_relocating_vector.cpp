@@ -0,0 +1,151 @@
+#include "relocating_vector.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <catch.hpp>
+
+#include <stdexcept>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Throws from the constructor taking `true`
+struct Picky {
+    explicit Picky(bool fail) {
+        if (fail) {
+            throw std::runtime_error("Picky");
+        }
+    }
+
+    SharedPtr<int> value = MakeShared<int>(1);
+};
+
+// The copy constructor throws once `copies_left` runs out
+struct Fragile {
+    explicit Fragile(SharedPtr<int> value) : value(std::move(value)) {
+    }
+
+    Fragile(const Fragile& other) : value(other.value) {
+        if (copies_left-- == 0) {
+            throw std::runtime_error("Fragile");
+        }
+    }
+
+    Fragile(Fragile&&) noexcept = default;
+    Fragile& operator=(Fragile&&) noexcept = default;
+
+    inline static int copies_left = 0;
+
+    SharedPtr<int> value;
+};
+
+}  // namespace
+
+template <>
+struct IsTriviallyRelocatable<Picky> : std::true_type {};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Relocatable pointers") {
+    static_assert(kIsTriviallyRelocatable<int*>);
+    static_assert(kIsTriviallyRelocatable<SharedPtr<int>>);
+    static_assert(kIsTriviallyRelocatable<SharedPtr<int[], SingleThreadedPolicy>>);
+    static_assert(kIsTriviallyRelocatable<WeakPtr<std::string>>);
+    static_assert(!kIsTriviallyRelocatable<std::string>);
+}
+
+TEST_CASE("RelocatingVector of SharedPtr") {
+    auto shared = MakeShared<int>(42);
+    RelocatingVector<SharedPtr<int>> vector;
+    for (int i = 0; i < 1000; ++i) {
+        vector.PushBack(i % 2 ? shared : MakeShared<int>(i));
+    }
+    REQUIRE(vector.Size() == 1000);
+    REQUIRE(vector.Capacity() >= 1000);
+    REQUIRE(shared.UseCount() == 501);
+    REQUIRE(*vector[998] == 998);
+
+    SECTION("Insert and erase") {
+        vector.Insert(vector.begin() + 10, shared);
+        REQUIRE(*vector[10] == 42);
+        REQUIRE(*vector[11] == 10);
+        REQUIRE(shared.UseCount() == 502);
+
+        auto next = vector.Erase(vector.begin(), vector.begin() + 10);
+        REQUIRE(next == vector.begin());
+        REQUIRE(*vector[0] == 42);
+        REQUIRE(vector.Size() == 991);
+        REQUIRE(shared.UseCount() == 497);
+
+        // The argument is an element of the vector
+        vector.Insert(vector.end() - 1, vector[1]);
+        REQUIRE(vector[vector.Size() - 2] == vector[1]);
+    }
+
+    SECTION("Copy and move") {
+        auto copy = vector;
+        REQUIRE(shared.UseCount() == 1001);
+        auto moved = std::move(copy);
+        REQUIRE(copy.Empty());
+        REQUIRE(moved[999] == shared);
+        moved = RelocatingVector<SharedPtr<int>>();
+        REQUIRE(shared.UseCount() == 501);
+    }
+
+    vector.Clear();
+    REQUIRE(shared.UseCount() == 1);
+}
+
+TEST_CASE("RelocatingVector of other types") {
+    RelocatingVector<std::string> strings;
+    for (int i = 0; i < 100; ++i) {
+        strings.EmplaceBack(std::to_string(i));
+    }
+    strings.Insert(strings.begin() + 1, std::string(100, 'x'));
+    strings.Erase(strings.begin());
+    REQUIRE(strings.Size() == 100);
+    REQUIRE(strings[0].size() == 100);
+    REQUIRE(strings[1] == "1");
+    REQUIRE(strings[99] == "99");
+    strings.PopBack();
+    REQUIRE(strings.Size() == 99);
+}
+
+TEST_CASE("RelocatingVector keeps its elements if a constructor throws") {
+    RelocatingVector<Picky> vector;
+    vector.Reserve(4);
+    vector.EmplaceBack(false);
+    vector.EmplaceBack(false);
+
+    REQUIRE_THROWS_AS(vector.Emplace(vector.begin(), true), std::runtime_error);
+    REQUIRE_THROWS_AS(vector.EmplaceBack(true), std::runtime_error);
+    for (int i = 0; i < 2; ++i) {
+        REQUIRE_THROWS_AS(vector.Emplace(vector.begin() + 1, true), std::runtime_error);
+        vector.EmplaceBack(false);
+    }
+    REQUIRE(vector.Size() == vector.Capacity());
+    REQUIRE_THROWS_AS(vector.Emplace(vector.begin() + 1, true), std::runtime_error);
+    REQUIRE(vector.Size() == 4);
+    for (auto& picky : vector) {
+        REQUIRE(picky.value.UseCount() == 1);
+    }
+}
+
+TEST_CASE("RelocatingVector copy frees the copied elements if a copy throws") {
+    auto value = MakeShared<int>(1);
+    RelocatingVector<Fragile> vector;
+    for (int i = 0; i < 4; ++i) {
+        vector.EmplaceBack(value);
+    }
+
+    Fragile::copies_left = 2;
+    REQUIRE_THROWS_AS(RelocatingVector<Fragile>(vector), std::runtime_error);
+    REQUIRE(value.UseCount() == 5);
+
+    Fragile::copies_left = 4;
+    RelocatingVector<Fragile> copy(vector);
+    REQUIRE(copy.Size() == 4);
+    REQUIRE(value.UseCount() == 9);
+}
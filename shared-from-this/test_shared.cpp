@@ -354,6 +354,33 @@ TEST_CASE("MakeShared") {
     }
 }
 
+TEST_CASE("MakeSharedForOverwrite") {
+    struct Packet {
+        size_t size;
+        unsigned char bytes[64 * 1024];
+    };
+
+    SECTION("One allocation") {
+        EXPECT_ONE_ALLOCATION({
+            auto packet = MakeSharedForOverwrite<Packet>();
+            packet->size = 3;
+            packet->bytes[packet->size - 1] = 42;
+            REQUIRE(packet->bytes[2] == 42);
+            REQUIRE(packet.UseCount() == 1);
+        });
+    }
+
+    SECTION("Default constructor runs") {
+        struct Header {
+            int version = 2;
+            size_t length;
+        };
+
+        auto header = MakeSharedForOverwrite<Header>();
+        REQUIRE(header->version == 2);
+    }
+}
+
 struct Data {
     static bool data_was_deleted;
 
@@ -0,0 +1,238 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <common/counted.h>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+constexpr int kThreads = 8;
+constexpr int kIterations = 100'000;
+
+template <typename F>
+void RunInThreads(int count, F func) {
+    std::vector<std::thread> threads;
+    threads.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        threads.emplace_back(func, i);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Packed counters") {
+    auto block = new InlineBlock<int>(42);
+    SharedPtr<int> sp(block, static_cast<int*>(block->GetRawPtr()));
+    WeakPtr<int> weak(sp);
+
+    // The largest strong count never leaks into the weak half
+    const size_t extra = ControlBlockBase::kMaxCount - 2;
+    block->IncStrongRef(extra);
+    REQUIRE(sp.UseCount() == ControlBlockBase::kMaxCount - 1);
+    REQUIRE(block->GetWeakCounter() == 2);
+    block->DecStrongRef(extra);
+    REQUIRE(sp.UseCount() == 1);
+
+    sp.Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE(block->GetWeakCounter() == 1);
+}
+
+TEST_CASE("Concurrent copies") {
+    std::atomic<int> destroyed = 0;
+    auto sp = MakeShared<Counted>(&destroyed);
+
+    RunInThreads(kThreads, [&sp](int) {
+        for (int i = 0; i < kIterations; ++i) {
+            SharedPtr<Counted> copy(sp);
+            SharedPtr<Counted> other = copy;
+            other = std::move(copy);
+        }
+    });
+
+    REQUIRE(sp.UseCount() == 1);
+    REQUIRE(destroyed == 0);
+    sp.Reset();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Concurrent last release") {
+    for (int round = 0; round < 1'000; ++round) {
+        std::atomic<int> destroyed = 0;
+        std::vector<SharedPtr<Counted>> copies(kThreads);
+        {
+            SharedPtr<Counted> sp(new Counted(&destroyed));
+            for (auto& copy : copies) {
+                copy = sp;
+            }
+        }
+
+        RunInThreads(kThreads, [&copies](int index) { copies[index].Reset(); });
+
+        REQUIRE(destroyed == 1);
+    }
+}
+
+TEST_CASE("Concurrent weak and strong release") {
+    for (int round = 0; round < 1'000; ++round) {
+        std::atomic<int> destroyed = 0;
+        std::vector<SharedPtr<Counted>> strong(kThreads / 2);
+        std::vector<WeakPtr<Counted>> weak(kThreads / 2);
+        {
+            auto sp = MakeShared<Counted>(&destroyed);
+            for (auto& ptr : strong) {
+                ptr = sp;
+            }
+            for (auto& ptr : weak) {
+                ptr = sp;
+            }
+        }
+
+        RunInThreads(kThreads, [&strong, &weak](int index) {
+            if (index % 2 == 0) {
+                strong[index / 2].Reset();
+            } else {
+                weak[index / 2].Reset();
+            }
+        });
+
+        REQUIRE(destroyed == 1);
+    }
+}
+
+TEST_CASE("Concurrent SharedFromThis") {
+    struct Node : EnableSharedFromThis<Node> {};
+
+    auto sp = MakeShared<Node>();
+    WeakPtr<Node> weak(sp);
+
+    RunInThreads(kThreads, [&sp](int) {
+        for (int i = 0; i < kIterations / 10; ++i) {
+            WeakPtr<Node> w = sp->WeakFromThis();
+            SharedPtr<Node> copy = sp;
+        }
+    });
+
+    REQUIRE(sp.UseCount() == 1);
+    sp.Reset();
+    REQUIRE(weak.Expired());
+}
+
+TEST_CASE("Concurrent Lock") {
+    struct Guarded {
+        ~Guarded() {
+            alive = false;
+        }
+
+        std::atomic<bool> alive = true;
+    };
+
+    for (int round = 0; round < 200; ++round) {
+        auto sp = MakeShared<Guarded>();
+        WeakPtr<Guarded> weak(sp);
+        std::atomic<bool> saw_dead = false;
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads - 1; ++i) {
+            threads.emplace_back([&weak, &saw_dead]() {
+                for (int j = 0; j < 1'000; ++j) {
+                    if (auto locked = weak.Lock()) {
+                        if (!locked->alive) {
+                            saw_dead = true;
+                        }
+                    }
+                    try {
+                        SharedPtr<Guarded> promoted(weak);
+                        if (!promoted->alive) {
+                            saw_dead = true;
+                        }
+                    } catch (const BadWeakPtr&) {
+                    }
+                }
+            });
+        }
+        sp.Reset();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        REQUIRE(!saw_dead);
+        REQUIRE(weak.Expired());
+        REQUIRE(weak.Lock().Get() == nullptr);
+    }
+
+    REQUIRE_THROWS_AS(SharedPtr<int>(WeakPtr<int>()), BadWeakPtr);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Single-threaded policy") {
+    using LocalPtr = SharedPtr<int, SingleThreadedPolicy>;
+    using LocalWeakPtr = WeakPtr<int, SingleThreadedPolicy>;
+
+    static_assert(!std::is_convertible_v<SharedPtr<int>, LocalPtr>);
+    static_assert(!std::is_convertible_v<LocalPtr, SharedPtr<int>>);
+    static_assert(!std::is_convertible_v<LocalWeakPtr, WeakPtr<int>>);
+    static_assert(sizeof(LocalPtr) == sizeof(SharedPtr<int>));
+
+    SECTION("Counting") {
+        auto sp = MakeShared<int, SingleThreadedPolicy>(42);
+        LocalWeakPtr weak(sp);
+        {
+            LocalPtr copy = sp;
+            REQUIRE(sp.UseCount() == 2);
+            REQUIRE(*weak.Lock() == 42);
+        }
+        REQUIRE(sp.UseCount() == 1);
+        sp.Reset();
+        REQUIRE(weak.Expired());
+    }
+
+    SECTION("Explicit conversions") {
+        LocalPtr local(new int(1));
+        SharedPtr<int> shared(local);
+        REQUIRE(shared.UseCount() == 2);
+
+        LocalPtr back(shared);
+        WeakPtr<int> weak(back);
+        LocalWeakPtr local_weak(weak);
+        REQUIRE(back.UseCount() == 3);
+
+        local.Reset();
+        back.Reset();
+        REQUIRE(!local_weak.Expired());
+        shared.Reset();
+        REQUIRE(local_weak.Expired());
+        REQUIRE(weak.Expired());
+    }
+
+    SECTION("Handing off to another thread") {
+        std::atomic<int> destroyed = 0;
+        SharedPtr<Counted, SingleThreadedPolicy> local(new Counted(&destroyed));
+        SharedPtr<Counted> shared(local);
+        local.Reset();
+
+        size_t use_count = 0;
+        std::thread([shared = std::move(shared), &use_count]() mutable {
+            SharedPtr<Counted, SingleThreadedPolicy> adopted(shared);
+            shared.Reset();
+            use_count = adopted.UseCount();
+        }).join();
+
+        REQUIRE(use_count == 1);
+        REQUIRE(destroyed == 1);
+    }
+}
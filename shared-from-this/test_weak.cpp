@@ -7,6 +7,62 @@
 
 #include "allocations_checker.h"
 
+#include <cstdint>
+#include <set>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Tile {
+    unsigned char bytes[SHARED_EARLY_RELEASE_BYTES];
+};
+
+struct SmallTile {
+    unsigned char bytes[16 * 1024];
+};
+
+struct KeptTile {
+    unsigned char bytes[16 * 1024];
+};
+
+#ifdef __linux__
+// Whether the page around the middle of [ptr, ptr + size) is in memory
+bool MiddlePageResident(const void* ptr, size_t size) {
+    auto page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t middle = (reinterpret_cast<uintptr_t>(ptr) + size / 2) & ~(page - 1);
+    unsigned char resident = 0;
+    mincore(reinterpret_cast<void*>(middle), page, &resident);
+    return resident & 1;
+}
+
+// Destroys the object behind `sp`, which must be its last `SharedPtr`, while a `WeakPtr` keeps
+// the block. Returns whether the storage stayed in memory
+template <typename T>
+bool ResidentAfterDestroy(SharedPtr<T>& sp, size_t size) {
+    WeakPtr<T> wp(sp);
+    const void* storage = sp.Get();
+    REQUIRE(MiddlePageResident(storage, size));
+    sp.Reset();
+    REQUIRE(wp.Expired());
+    return MiddlePageResident(storage, size);
+}
+#endif
+
+}  // namespace
+
+template <>
+struct EarlyRelease<SmallTile> : std::true_type {};
+
+template <>
+struct EarlyRelease<KeptTile[]> : std::false_type {};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 TEST_CASE("Empty weak") {
@@ -175,3 +231,67 @@ TEST_CASE("Lifetimes") {
         delete wp;
     }
 }
+
+TEST_CASE("Owner-based ordering and hashing") {
+    struct Pair {
+        int first;
+        int second;
+    };
+
+    auto pair = MakeShared<Pair>(Pair{1, 2});
+    SharedPtr<int> first(pair, &pair->first);
+    SharedPtr<int> second(pair, &pair->second);
+    WeakPtr<int> weak(second);
+    auto other = MakeShared<int>(1);
+    SharedPtr<int> empty;
+
+    REQUIRE_FALSE(first == second);
+    REQUIRE(first.OwnerEqual(second));
+    REQUIRE(first.OwnerEqual(weak));
+    REQUIRE(weak.OwnerEqual(pair));
+    REQUIRE_FALSE(first.OwnerBefore(weak));
+    REQUIRE_FALSE(weak.OwnerBefore(first));
+    REQUIRE(first.OwnerHash() == weak.OwnerHash());
+    REQUIRE_FALSE(first.OwnerEqual(other));
+    REQUIRE(first.OwnerBefore(other) != other.OwnerBefore(first));
+    REQUIRE(empty.OwnerEqual(WeakPtr<int>()));
+
+    std::set<WeakPtr<int>, OwnerLess> ordered{weak, WeakPtr<int>(first), WeakPtr<int>(other)};
+    REQUIRE(ordered.size() == 2);
+    REQUIRE(ordered.count(pair) == 1);
+
+    std::unordered_set<WeakPtr<int>, OwnerHasher, OwnerEqualTo> hashed{weak, WeakPtr<int>(first)};
+    REQUIRE(hashed.size() == 1);
+    REQUIRE(hashed.find(second) != hashed.end());
+
+    // Still equivalent once the object has expired
+    pair.Reset();
+    first.Reset();
+    second.Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE(hashed.find(weak) != hashed.end());
+    REQUIRE(ordered.count(weak) == 1);
+}
+
+#ifdef __linux__
+TEST_CASE("Early release of large objects") {
+    static_assert(EarlyRelease<Tile>::value);
+    static_assert(!EarlyRelease<KeptTile>::value);
+
+    auto tile = MakeShared<Tile>();
+    REQUIRE_FALSE(ResidentAfterDestroy(tile, sizeof(Tile)));
+
+    auto small = MakeShared<SmallTile>();
+    REQUIRE_FALSE(ResidentAfterDestroy(small, sizeof(SmallTile)));
+
+    auto kept = MakeShared<KeptTile>();
+    REQUIRE(ResidentAfterDestroy(kept, sizeof(KeptTile)));
+
+    auto array = MakeShared<unsigned char[]>(SHARED_EARLY_RELEASE_BYTES);
+    REQUIRE_FALSE(ResidentAfterDestroy(array, SHARED_EARLY_RELEASE_BYTES));
+
+    constexpr size_t kKeptTiles = SHARED_EARLY_RELEASE_BYTES / sizeof(KeptTile) + 1;
+    auto kept_array = MakeShared<KeptTile[]>(kKeptTiles);
+    REQUIRE(ResidentAfterDestroy(kept_array, kKeptTiles * sizeof(KeptTile)));
+}
+#endif
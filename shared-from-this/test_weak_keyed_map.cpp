@@ -0,0 +1,93 @@
+#include "weak_keyed_map.h"
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Session {
+    int id;
+};
+
+using SessionMap = WeakKeyedMap<Session, std::string>;
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("WeakKeyedMap lookups") {
+    SessionMap map;
+    auto first = MakeShared<Session>(Session{1});
+    auto second = MakeShared<Session>(Session{2});
+    REQUIRE(map.Empty());
+    REQUIRE(map.Find(first) == nullptr);
+
+    map.InsertOrAssign(first, "first");
+    map.InsertOrAssign(second, "second");
+    REQUIRE(map.Size() == 2);
+    REQUIRE(*map.Find(first) == "first");
+
+    // Keyed by the owner, not by the address
+    SharedPtr<int> id(second, &second->id);
+    REQUIRE(*map.Find(id) == "second");
+
+    REQUIRE(map.InsertOrAssign(second, "replaced") == "replaced");
+    REQUIRE(map.Size() == 2);
+    REQUIRE(*map.Find(second) == "replaced");
+
+    const SessionMap& const_map = map;
+    REQUIRE(*const_map.Find(first) == "first");
+
+    REQUIRE(map.Erase(first));
+    REQUIRE_FALSE(map.Erase(first));
+    REQUIRE(map.Find(first) == nullptr);
+    REQUIRE(map.Size() == 1);
+
+    map.Clear();
+    REQUIRE(map.Empty());
+}
+
+TEST_CASE("WeakKeyedMap does not keep keys alive") {
+    SessionMap map;
+    auto session = MakeShared<Session>(Session{1});
+    WeakPtr<Session> weak(session);
+    map.InsertOrAssign(session, "value");
+    REQUIRE(session.UseCount() == 1);
+
+    session.Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE(map.Size() == 1);
+    REQUIRE(map.SweepAll() == 1);
+    REQUIRE(map.Empty());
+    REQUIRE(map.SweepAll() == 0);
+}
+
+TEST_CASE("WeakKeyedMap sweeps expired entries on insert") {
+    constexpr size_t kLive = 100;
+    constexpr size_t kRounds = 100;
+
+    SessionMap map;
+    std::vector<SharedPtr<Session>> live(kLive);
+    size_t largest = 0;
+    for (size_t round = 0; round < kRounds; ++round) {
+        for (size_t i = 0; i < kLive; ++i) {
+            // Drops the key inserted in the previous round
+            live[i] = MakeShared<Session>(Session{static_cast<int>(round * kLive + i)});
+            map.InsertOrAssign(live[i], std::to_string(live[i]->id));
+            largest = std::max(largest, map.Size());
+        }
+    }
+
+    // Bounded by the live keys, not by all keys ever inserted
+    REQUIRE(largest < 4 * kLive);
+    for (const auto& session : live) {
+        REQUIRE(*map.Find(session) == std::to_string(session->id));
+    }
+    live.clear();
+    map.SweepAll();
+    REQUIRE(map.Empty());
+}
@@ -4,15 +4,22 @@
 #include "shared.h"
 
 // https://en.cppreference.com/w/cpp/memory/weak_ptr
-template <typename T>
+template <typename T, typename Policy>
 class WeakPtr {
-    template <typename Y>
+    template <typename Y, typename OtherPolicy>
     friend class SharedPtr;
 
-    template <typename Y>
+    template <typename Y, typename OtherPolicy>
     friend class WeakPtr;
 
+    template <typename Ptr>
+    friend class AtomicPtrBase;
+
+    using Block = typename Policy::BlockBase;
+
 public:
+    using element_type = std::remove_extent_t<T>;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
@@ -29,19 +36,49 @@ public:
     }
 
     template <typename Y>
-    WeakPtr(const WeakPtr<Y>& other) : control_block_(other.control_block_), ptr_(other.ptr_) {
+        requires CompatiblePointer<Y, T>
+    WeakPtr(const WeakPtr<Y, Policy>& other)
+        : control_block_(other.control_block_), ptr_(other.ptr_) {
         IncreaseWeakCounter();
     }
 
     template <typename Y>
-    WeakPtr(WeakPtr<Y>&& other) noexcept : control_block_(other.control_block_), ptr_(other.ptr_) {
+        requires CompatiblePointer<Y, T>
+    WeakPtr(WeakPtr<Y, Policy>&& other) noexcept
+        : control_block_(other.control_block_), ptr_(other.ptr_) {
         IncreaseWeakCounter();
         other.Reset();
     }
 
+    // Switch threading policy, see `SharedPtr`
+    template <typename Y, typename OtherPolicy>
+        requires CompatiblePointer<Y, T>
+    explicit WeakPtr(const WeakPtr<Y, OtherPolicy>& other)
+        : control_block_(other.control_block_), ptr_(other.ptr_) {
+        static_assert(std::is_same_v<typename OtherPolicy::BlockBase, Block>,
+                      "Policies with different control blocks are not convertible");
+        if (control_block_) {
+            control_block_->template AdoptThread<Policy>();
+        }
+        IncreaseWeakCounter();
+    }
+
     // Demote `SharedPtr`
     // #2 from https://en.cppreference.com/w/cpp/memory/weak_ptr/weak_ptr
-    WeakPtr(const SharedPtr<T>& other) : control_block_(other.control_block_), ptr_(other.ptr_) {
+    WeakPtr(const SharedPtr<T, Policy>& other)
+        : control_block_(other.control_block_), ptr_(other.ptr_) {
+        IncreaseWeakCounter();
+    }
+
+    template <typename Y, typename OtherPolicy>
+        requires CompatiblePointer<Y, T>
+    explicit WeakPtr(const SharedPtr<Y, OtherPolicy>& other)
+        : control_block_(other.control_block_), ptr_(other.ptr_) {
+        static_assert(std::is_same_v<typename OtherPolicy::BlockBase, Block>,
+                      "Policies with different control blocks are not convertible");
+        if (control_block_) {
+            control_block_->template AdoptThread<Policy>();
+        }
         IncreaseWeakCounter();
     }
 
@@ -97,34 +134,56 @@ public:
         return 0;
     }
 
+    // A retired `HazardPolicy` object is expired before it is destroyed
     bool Expired() const {
-        return control_block_ == nullptr || control_block_->IsDestroyed();
+        return UseCount() == 0;
     }
 
-    SharedPtr<T> Lock() const {
-        if (!Expired()) {
-            return SharedPtr<T>(control_block_, ptr_);
+    SharedPtr<T, Policy> Lock() const {
+        if (control_block_ && control_block_->template TryIncStrongRef<Policy>()) {
+            return SharedPtr<T, Policy>::Adopt(control_block_, ptr_);
         }
-        return SharedPtr<T>();
+        return SharedPtr<T, Policy>();
+    }
+
+    // See `SharedPtr::OwnerBefore`
+    template <typename Y, typename OtherPolicy>
+    bool OwnerBefore(const WeakPtr<Y, OtherPolicy>& other) const {
+        return std::less<const void*>()(control_block_, other.control_block_);
+    }
+
+    template <typename Y, typename OtherPolicy>
+    bool OwnerBefore(const SharedPtr<Y, OtherPolicy>& other) const {
+        return std::less<const void*>()(control_block_, other.control_block_);
+    }
+
+    template <typename Y, typename OtherPolicy>
+    bool OwnerEqual(const WeakPtr<Y, OtherPolicy>& other) const {
+        return static_cast<const void*>(control_block_) == other.control_block_;
+    }
+
+    template <typename Y, typename OtherPolicy>
+    bool OwnerEqual(const SharedPtr<Y, OtherPolicy>& other) const {
+        return static_cast<const void*>(control_block_) == other.control_block_;
+    }
+
+    size_t OwnerHash() const {
+        return std::hash<const void*>()(control_block_);
     }
 
 private:
-    ControlBlockBase* control_block_ = nullptr;
-    T* ptr_ = nullptr;
-    bool is_esft_ptr_ = false;
+    Block* control_block_ = nullptr;
+    element_type* ptr_ = nullptr;
 
     void IncreaseWeakCounter() {
         if (control_block_) {
-            control_block_->IncWeakRef();
+            control_block_->template IncWeakRef<Policy>();
         }
     }
 
     void DecreaseWeakCounter() {
-        if (control_block_) {
-            control_block_->DecWeakRef();
-            if (!is_esft_ptr_ && control_block_->CanDeleteControlBlock()) {
-                delete control_block_;
-            }
+        if (control_block_ && control_block_->template DecWeakRef<Policy>() == 0) {
+            control_block_->Delete();
         }
     }
 
@@ -135,7 +194,44 @@ private:
         return 0;
     }
 
-    void MakeEsftPtr() {
-        is_esft_ptr_ = true;
+    // Takes over a weak reference the caller has already counted
+    static WeakPtr Adopt(Block* block, element_type* ptr) {
+        WeakPtr result;
+        result.control_block_ = block;
+        result.ptr_ = ptr;
+        return result;
+    }
+};
+
+template <typename T, typename Policy>
+struct IsTriviallyRelocatable<WeakPtr<T, Policy>> : std::true_type {};
+
+// `std::owner_less`, `std::owner_hash` and `std::owner_equal` for both pointer kinds, e.g.
+// `std::unordered_map<WeakPtr<T>, V, OwnerHasher, OwnerEqualTo>`. Transparent, so that such a map
+// is searched with a `SharedPtr` without taking a weak reference
+struct OwnerLess {
+    using is_transparent = void;
+
+    template <typename A, typename B>
+    bool operator()(const A& left, const B& right) const {
+        return left.OwnerBefore(right);
+    }
+};
+
+struct OwnerHasher {
+    using is_transparent = void;
+
+    template <typename A>
+    size_t operator()(const A& ptr) const {
+        return ptr.OwnerHash();
+    }
+};
+
+struct OwnerEqualTo {
+    using is_transparent = void;
+
+    template <typename A, typename B>
+    bool operator()(const A& left, const B& right) const {
+        return left.OwnerEqual(right);
     }
 };
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "weak.h"
+
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+
+// A side table keyed by object identity that does not keep its keys alive. An entry whose key
+// has expired still holds the control block, and with `MakeShared` the object's storage too, so
+// every insert sweeps the next `kSweepPerInsert` buckets and erases such entries. Expired entries
+// are erased without a pause for a full pass, but only as fast as the inserts walk the buckets.
+//
+// Not thread-safe, like the standard containers
+template <typename K, typename V, typename Policy = AtomicPolicy>
+class WeakKeyedMap {
+public:
+    using Key = WeakPtr<K, Policy>;
+
+    // Every entry is checked at least once per `bucket_count / kSweepPerInsert` inserts. The
+    // bucket count never shrinks, so once many keys have expired this is set by the largest size
+    // the map has had, not by `Size()`. Call `SweepAll()` after a mass expiry to erase them at once
+    static constexpr size_t kSweepPerInsert = 2;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Inserts `value` for `key`, or replaces the value it has
+    V& InsertOrAssign(const SharedPtr<K, Policy>& key, V value) {
+        Sweep(kSweepPerInsert);
+        if (auto it = map_.find(key); it != map_.end()) {
+            it->second = std::move(value);
+            return it->second;
+        }
+        return map_.emplace(Key(key), std::move(value)).first->second;
+    }
+
+    template <typename Y>
+    bool Erase(const SharedPtr<Y, Policy>& key) {
+        auto it = map_.find(key);
+        if (it == map_.end()) {
+            return false;
+        }
+        map_.erase(it);
+        return true;
+    }
+
+    // Erases every expired entry at once. Returns the number of entries erased
+    size_t SweepAll() {
+        return Sweep(map_.bucket_count());
+    }
+
+    void Clear() {
+        map_.clear();
+        cursor_ = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // Any pointer that shares the owner of a key finds it. A live key never shares its control
+    // block with an expired one, so lookups never see expired entries
+    template <typename Y>
+    V* Find(const SharedPtr<Y, Policy>& key) {
+        auto it = map_.find(key);
+        return it == map_.end() ? nullptr : &it->second;
+    }
+
+    template <typename Y>
+    const V* Find(const SharedPtr<Y, Policy>& key) const {
+        auto it = map_.find(key);
+        return it == map_.end() ? nullptr : &it->second;
+    }
+
+    // Includes expired entries that have not been swept yet
+    size_t Size() const {
+        return map_.size();
+    }
+
+    bool Empty() const {
+        return map_.empty();
+    }
+
+private:
+    std::unordered_map<Key, V, OwnerHasher, OwnerEqualTo> map_;
+    // The next bucket to sweep. A rehash only moves it to another bucket
+    size_t cursor_ = 0;
+
+    size_t Sweep(size_t buckets) {
+        size_t erased = 0;
+        for (size_t i = 0; i < buckets && !map_.empty(); ++i) {
+            size_t bucket = cursor_++ % map_.bucket_count();
+            for (auto local = map_.begin(bucket); local != map_.end(bucket);) {
+                if (local->first.Expired()) {
+                    // Erasing invalidates only the erased entry
+                    auto it = map_.find(local->first);
+                    ++local;
+                    map_.erase(it);
+                    ++erased;
+                } else {
+                    ++local;
+                }
+            }
+        }
+        return erased;
+    }
+};
@@ -2,21 +2,27 @@
 
 #include "sw_fwd.h"  // Forward declaration
 
+#include <atomic>
 #include <cstddef>  // std::nullptr_t
 
 struct ControlBlockBase {
-    size_t counter = 1;
+    std::atomic<size_t> counter = 1;
 
     size_t IncRef() {
-        return ++counter;
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
     }
 
     size_t DecRef() {
-        return --counter;
+        size_t result = counter.fetch_sub(1, std::memory_order_release) - 1;
+        if (result == 0) {
+            // Synchronize with all previous releases before the object is destroyed
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return result;
     }
 
     size_t GetCounter() const {
-        return counter;
+        return counter.load(std::memory_order_relaxed);
     }
 
     virtual void* GetRawPtr() = 0;
@@ -36,7 +42,6 @@ struct DefaultBlock : ControlBlockBase {
         if (deletem_ptr) {
             delete deletem_ptr;
         }
-        counter = 0;
     }
 
     void* GetRawPtr() override {
@@ -53,7 +58,6 @@ struct InlineBlock : ControlBlockBase {
     }
 
     void Destroy() override {
-        counter = 0;
     }
 
     void* GetRawPtr() override {
@@ -185,12 +189,9 @@ public:
         }
     }
     void DecreaseCounter() {
-        if (control_block_) {
-            control_block_->DecRef();
-            if (control_block_->GetCounter() == 0) {
-                control_block_->Destroy();
-                delete control_block_;
-            }
+        if (control_block_ && control_block_->DecRef() == 0) {
+            control_block_->Destroy();
+            delete control_block_;
         }
     }
     size_t GetCounter() const {
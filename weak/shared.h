@@ -2,43 +2,65 @@
 
 #include "sw_fwd.h"  // Forward declaration
 
+#include <atomic>
 #include <cstddef>  // std::nullptr_t
 #include <iostream>
+
+// All `SharedPtr`-s of a block share one extra weak reference, which is dropped right after
+// `Destroy()`. That way only the owner of the last weak reference deletes the block.
 struct ControlBlockBase {
-    size_t strong_ref_cnt = 1;
-    size_t weak_ref_cnt = 0;
-    bool is_destroyed = false;
+    std::atomic<size_t> strong_ref_cnt = 1;
+    std::atomic<size_t> weak_ref_cnt = 1;
+    std::atomic<bool> is_destroyed = false;
 
     size_t IncStrongRef() {
-        return ++strong_ref_cnt;
+        return strong_ref_cnt.fetch_add(1, std::memory_order_relaxed) + 1;
     }
 
     size_t DecStrongRef() {
-        return --strong_ref_cnt;
+        size_t result = strong_ref_cnt.fetch_sub(1, std::memory_order_release) - 1;
+        if (result == 0) {
+            // Synchronize with all previous releases before the object is destroyed
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return result;
+    }
+
+    // Never revives an object whose strong count has already dropped to zero
+    bool TryIncStrongRef() {
+        size_t current = strong_ref_cnt.load(std::memory_order_relaxed);
+        do {
+            if (current == 0) {
+                return false;
+            }
+        } while (!strong_ref_cnt.compare_exchange_weak(current, current + 1,
+                                                       std::memory_order_acquire,
+                                                       std::memory_order_relaxed));
+        return true;
     }
 
     size_t GetStrongCounter() const {
-        return strong_ref_cnt;
+        return strong_ref_cnt.load(std::memory_order_relaxed);
     }
 
     size_t IncWeakRef() {
-        return ++weak_ref_cnt;
+        return weak_ref_cnt.fetch_add(1, std::memory_order_relaxed) + 1;
     }
 
     size_t DecWeakRef() {
-        return --weak_ref_cnt;
+        size_t result = weak_ref_cnt.fetch_sub(1, std::memory_order_release) - 1;
+        if (result == 0) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return result;
     }
 
     size_t GetWeakCounter() const {
-        return weak_ref_cnt;
-    }
-
-    size_t GetAllCounter() const {
-        return strong_ref_cnt + weak_ref_cnt;
+        return weak_ref_cnt.load(std::memory_order_relaxed);
     }
 
     bool IsDestroyed() const {
-        return is_destroyed;
+        return is_destroyed.load(std::memory_order_acquire);
     }
 
     virtual void* GetRawPtr() = 0;
@@ -59,8 +81,7 @@ struct DefaultBlock : ControlBlockBase {
             if (deletem_ptr) {
                 delete deletem_ptr;
             }
-            strong_ref_cnt = 0;
-            is_destroyed = true;
+            is_destroyed.store(true, std::memory_order_release);
         }
     }
 
@@ -81,8 +102,7 @@ struct InlineBlock : ControlBlockBase {
     void Destroy() override {
         if (!is_destroyed) {
             reinterpret_cast<T*>(storage)->~T();
-            strong_ref_cnt = 0;
-            is_destroyed = true;
+            is_destroyed.store(true, std::memory_order_release);
         }
     }
 
@@ -144,10 +164,11 @@ public:
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     explicit SharedPtr(const WeakPtr<T>& other)
         : control_block_(other.control_block_), ptr_(other.ptr_) {
-        if (control_block_->IsDestroyed()) {
+        if (!control_block_ || !control_block_->TryIncStrongRef()) {
+            control_block_ = nullptr;
+            ptr_ = nullptr;
             throw BadWeakPtr();
         }
-        IncreaseCounter();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -223,13 +244,10 @@ public:
         }
     }
     void DecreaseCounter() {
-        if (control_block_) {
-            control_block_->DecStrongRef();
-            if (control_block_->GetStrongCounter() == 0) {
-                control_block_->Destroy();
-                if (control_block_->GetAllCounter() == 0) {
-                    delete control_block_;
-                }
+        if (control_block_ && control_block_->DecStrongRef() == 0) {
+            control_block_->Destroy();
+            if (control_block_->DecWeakRef() == 0) {
+                delete control_block_;
             }
         }
     }
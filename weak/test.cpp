@@ -7,6 +7,9 @@
 
 #include "allocations_checker.h"
 
+#include <string>
+#include <thread>
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 TEST_CASE("Empty weak") {
@@ -147,6 +150,26 @@ TEST_CASE("Shared from invalid Weak") {
     REQUIRE_THROWS_AS(SharedPtr<int>(w_ptr), BadWeakPtr);
 }
 
+TEST_CASE("Lock races with the last release") {
+    constexpr int kRounds = 1'000;
+
+    for (int round = 0; round < kRounds; ++round) {
+        auto shared = MakeShared<std::string>("a string long enough to live on the heap");
+        WeakPtr<std::string> weak = shared;
+        bool intact = true;
+        std::thread locker([&weak, &intact]() {
+            while (auto locked = weak.Lock()) {
+                intact = intact && locked->size() == 40;
+            }
+        });
+        shared.Reset();
+        locker.join();
+        REQUIRE(intact);
+        REQUIRE(weak.Expired());
+        REQUIRE_THROWS_AS(SharedPtr<std::string>(weak), BadWeakPtr);
+    }
+}
+
 TEST_CASE("Constness") {
     SharedPtr<int> sp(new int(42));
     WeakPtr<const int> wp(sp);
@@ -95,8 +95,7 @@ public:
         return control_block_ == nullptr || control_block_->IsDestroyed();
     }
     SharedPtr<T> Lock() const {
-        if (!Expired()) {
-            control_block_->IncStrongRef();
+        if (control_block_ && control_block_->TryIncStrongRef()) {
             return SharedPtr<T>(control_block_, ptr_);
         }
         return SharedPtr<T>();
@@ -112,11 +111,8 @@ public:
     }
 
     void DecreaseWeakCounter() {
-        if (control_block_) {
-            control_block_->DecWeakRef();
-            if (control_block_->GetAllCounter() == 0) {
-                delete control_block_;
-            }
+        if (control_block_ && control_block_->DecWeakRef() == 0) {
+            delete control_block_;
         }
     }
     size_t GetWeakCounter() const {